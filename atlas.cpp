@@ -0,0 +1,49 @@
+#include <cmath>
+
+#include "atlas.h"
+
+void atlas_init(struct atlas *a, GLuint cells, GLuint balls_per_cell)
+{
+	a->header.columns = (GLuint)std::ceil(std::sqrt((double)cells));
+	a->header.rows = (cells + a->header.columns - 1) / a->header.columns;
+	a->header.cells = cells;
+	a->header.pad = 0;
+	a->balls_per_cell = balls_per_cell;
+	a->balls.assign((size_t)cells * balls_per_cell, atlas_ball());
+	a->ssbo = 0;
+}
+
+void atlas_destroy(struct atlas *a)
+{
+	glDeleteBuffers(1, &(a->ssbo));
+	a->ssbo = 0;
+}
+
+void atlas_set_cell(struct atlas *a, GLuint cell, const GLfloat *pos_rad,
+                    const GLfloat *color, const GLfloat *params)
+{
+	struct atlas_ball *b = a->balls.data() + (size_t)cell * a->balls_per_cell;
+
+	for (GLuint i = 0; i < a->balls_per_cell; i++, b++) {
+		for (int j = 0; j < 3; j++) {
+			b->pos_rad[j] = pos_rad[i * 3 + j];
+			b->color[j] = color[i * 3 + j];
+		}
+		for (int j = 0; j < 4; j++)
+			b->params[j] = params[i * 4 + j];
+	}
+}
+
+void atlas_upload(struct atlas *a)
+{
+	GLsizeiptr balls_sz = a->balls.size() * sizeof(struct atlas_ball);
+
+	// Written once and only read by the GPU from then on
+	glGenBuffers(1, &(a->ssbo));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, a->ssbo);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(struct atlas_header) + balls_sz, NULL,
+	                GL_DYNAMIC_STORAGE_BIT);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(struct atlas_header), &(a->header));
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(struct atlas_header), balls_sz, a->balls.data());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ATLAS_BINDING, a->ssbo);
+}
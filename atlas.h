@@ -0,0 +1,57 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// Shader storage binding of the atlas block in fs.glsl
+#define ATLAS_BINDING 1
+
+#define ATLAS_DEFAULT_COUNT 256
+#define ATLAS_DEFAULT_CELL_WIDTH 160
+#define ATLAS_DEFAULT_CELL_HEIGHT 90
+
+// Thumbnails of count consecutive seeds, written out as one PNG
+struct atlas_config {
+	GLuint count;
+	int cell_width, cell_height;
+	unsigned frame; // Of the animation, counting from 1
+	const char *path;
+};
+
+// Must match the std430 layout of atlas_ball in fs.glsl
+struct atlas_ball {
+	GLfloat pos_rad[4];
+	GLfloat color[4];
+	GLfloat params[4];
+};
+
+// Must match the std430 layout of the atlas block in fs.glsl, which is
+// followed by the balls of every cell, one cell after the other
+struct atlas_header {
+	GLuint columns, rows;
+	GLuint cells;
+	GLuint pad;
+};
+
+// Many scenes drawn at once as a grid of cells, each with balls of its own.
+// Cells go row by row from the top left, the last row may not be full
+struct atlas {
+	struct atlas_header header;
+	GLuint balls_per_cell;
+	std::vector<struct atlas_ball> balls;
+	GLuint ssbo;
+};
+
+// Lays the cells out about as many cells wide as high
+void atlas_init(struct atlas *a, GLuint cells, GLuint balls_per_cell);
+void atlas_destroy(struct atlas *a);
+
+// Takes the usual ball arrays, xyz, xyz and xyzw per ball
+void atlas_set_cell(struct atlas *a, GLuint cell, const GLfloat *pos_rad,
+                    const GLfloat *color, const GLfloat *params);
+
+// Uploads every cell and binds the buffer to ATLAS_BINDING
+void atlas_upload(struct atlas *a);
+
+#endif
@@ -0,0 +1,457 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+#define LINE_SZ 4096
+
+// Frame times are strongly autocorrelated (a hitch tends to last several
+// frames), so resample runs of consecutive frames instead of single frames
+#define BOOTSTRAP_BLOCK_LEN 32
+
+void bench_run_init(struct bench_run *run, const struct bench_config *config)
+{
+	run->config = *config;
+	run->frames_seen = 0;
+	run->frame_us.clear();
+	run->gpu_us.clear();
+	run->frame_us.reserve(config->frames);
+	run->gpu_us.reserve(config->frames);
+}
+
+bool bench_add_frame(struct bench_run *run, float frame_us)
+{
+	run->frames_seen++;
+	if (run->frames_seen > run->config.warmup)
+		run->frame_us.push_back(frame_us);
+
+	return run->frame_us.size() >= run->config.frames;
+}
+
+void bench_add_gpu_time(struct bench_run *run, float gpu_us)
+{
+	if (run->frames_seen > run->config.warmup && run->gpu_us.size() < run->config.frames)
+		run->gpu_us.push_back(gpu_us);
+}
+
+std::string bench_cpu_model(void)
+{
+	std::string model = "unknown";
+	char line[LINE_SZ];
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	if (f == NULL)
+		return model;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char *colon;
+		if (strncmp(line, "model name", 10) != 0)
+			continue;
+
+		colon = strchr(line, ':');
+		if (colon == NULL)
+			continue;
+
+		colon++;
+		while (*colon == ' ' || *colon == '\t')
+			colon++;
+		colon[strcspn(colon, "\n")] = '\0';
+		model = colon;
+		break;
+	}
+	fclose(f);
+	return model;
+}
+
+static void json_append_string(std::string &dst, const std::string &s)
+{
+	dst += '"';
+	for (auto it = s.begin(); it != s.end(); ++it) {
+		char c = *it;
+		if (c == '"' || c == '\\') {
+			dst += '\\';
+			dst += c;
+		} else if ((unsigned char)c < 0x20) {
+			char esc[8];
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			dst += esc;
+		} else {
+			dst += c;
+		}
+	}
+	dst += '"';
+}
+
+static void json_append_array(std::string &dst, const std::vector<float> &v)
+{
+	char num[32];
+
+	dst += '[';
+	for (size_t i = 0; i < v.size(); i++) {
+		snprintf(num, sizeof(num), i == 0 ? "%.2f" : ",%.2f", v[i]);
+		dst += num;
+	}
+	dst += ']';
+}
+
+static float percentile(std::vector<float> v, float p)
+{
+	size_t n;
+	if (v.empty())
+		return 0.0f;
+
+	n = std::min((size_t)(p * v.size()), v.size() - 1);
+	std::nth_element(v.begin(), v.begin() + n, v.end());
+	return v[n];
+}
+
+std::string bench_run_to_json(const struct bench_run *run)
+{
+	const struct bench_config *c = &(run->config);
+	std::string json;
+	char buf[512];
+	char date[32];
+	time_t now = time(NULL);
+	struct tm tm;
+
+	gmtime_r(&now, &tm);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+	json += "{\"commit\":";
+	json_append_string(json, run->commit);
+	json += ",\"date\":";
+	json_append_string(json, date);
+	json += ",\"cpu\":";
+	json_append_string(json, run->cpu);
+	json += ",\"renderer\":";
+	json_append_string(json, run->renderer);
+	json += ",\"gl_version\":";
+	json_append_string(json, run->gl_version);
+
+	snprintf(buf, sizeof(buf),
+	         ",\"config\":{\"frames\":%u,\"warmup\":%u,\"num_balls\":%u,"
+	         "\"width\":%u,\"height\":%u,\"seed\":%u,\"frames_in_flight\":%u,"
+	         "\"tail_critical_value\":%.3f,\"friction\":%.4f,\"compute\":%s}",
+	         c->frames, c->warmup, c->num_balls, c->width, c->height,
+	         c->seed, c->frames_in_flight, c->tail_critical_value, c->friction,
+	         c->compute ? "true" : "false");
+	json += buf;
+
+	snprintf(buf, sizeof(buf),
+	         ",\"summary\":{\"frame_us_p50\":%.2f,\"frame_us_p99\":%.2f,"
+	         "\"gpu_us_p50\":%.2f,\"gpu_us_p99\":%.2f}",
+	         percentile(run->frame_us, 0.5f), percentile(run->frame_us, 0.99f),
+	         percentile(run->gpu_us, 0.5f), percentile(run->gpu_us, 0.99f));
+	json += buf;
+
+	json += ",\"frame_us\":";
+	json_append_array(json, run->frame_us);
+	json += ",\"gpu_us\":";
+	json_append_array(json, run->gpu_us);
+	json += '}';
+	return json;
+}
+
+int bench_append_result(const char *fn, const std::string &json)
+{
+	int rv = 0;
+	std::string line = json + "\n";
+
+	// A single O_APPEND write keeps concurrent runs from interleaving lines
+	int fd = open(fn, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", fn, strerror(errno));
+		rv = 1;
+		goto out;
+	}
+	if (write(fd, line.data(), line.size()) != (ssize_t)line.size()) {
+		fprintf(stderr, "Failed to write %s: %s\n", fn, strerror(errno));
+		rv = 1;
+	}
+	close(fd);
+out:
+	return rv;
+}
+
+// Only understands what bench_run_to_json writes, which is all the results
+// file is supposed to contain
+static const char *json_find_key(const char *json, const char *key)
+{
+	size_t keylen = strlen(key);
+	const char *p = json;
+
+	while ((p = strchr(p, '"')) != NULL) {
+		p++;
+		if (strncmp(p, key, keylen) == 0 && p[keylen] == '"' && p[keylen + 1] == ':')
+			return p + keylen + 2;
+	}
+	return NULL;
+}
+
+static bool json_get_string(const char *json, const char *key, std::string *dst)
+{
+	const char *p = json_find_key(json, key);
+	if (p == NULL || *p != '"')
+		return false;
+
+	dst->clear();
+	for (p++; *p != '\0' && *p != '"'; p++) {
+		if (*p == '\\' && p[1] != '\0')
+			p++;
+		*dst += *p;
+	}
+	return *p == '"';
+}
+
+static bool json_get_array(const char *json, const char *key, std::vector<float> *dst)
+{
+	const char *p = json_find_key(json, key);
+	if (p == NULL || *p != '[')
+		return false;
+
+	p++;
+	while (*p != ']' && *p != '\0') {
+		char *end;
+		float f = strtof(p, &end);
+		if (end == p)
+			return false;
+		dst->push_back(f);
+		p = end;
+		if (*p == ',')
+			p++;
+	}
+	return *p == ']';
+}
+
+static bool json_get_object(const char *json, const char *key, std::string *dst)
+{
+	const char *p = json_find_key(json, key);
+	const char *end;
+	if (p == NULL || *p != '{')
+		return false;
+
+	// Objects are flat in the results file
+	end = strchr(p, '}');
+	if (end == NULL)
+		return false;
+	dst->assign(p, end + 1);
+	return true;
+}
+
+// Per run, so resampling never puts frames of different runs into a block
+struct run_samples {
+	std::vector<std::vector<float> > frame_us;
+	std::vector<std::vector<float> > gpu_us;
+};
+
+// Runs are only comparable if they were made with the same settings on the
+// same machine
+struct setup_samples {
+	std::string config;
+	std::string cpu;
+	std::string renderer;
+	struct run_samples base, head;
+};
+
+// A prefix of a commit matches, but a clean commit does not match the runs
+// of its dirty tree
+static bool commit_matches(const std::string &commit, const char *want)
+{
+	size_t len = strlen(want);
+	return commit.compare(0, len, want) == 0 && commit.find('-', len) == std::string::npos;
+}
+
+static int read_samples(const char *fn, const char *base, const char *head,
+                        std::vector<struct setup_samples> *setups)
+{
+	int rv = 0;
+	std::string line;
+	char buf[LINE_SZ];
+	FILE *f = fopen(fn, "r");
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", fn, strerror(errno));
+		rv = 1;
+		goto out;
+	}
+
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		std::string commit, config, cpu, renderer;
+		struct setup_samples *setup = NULL;
+		struct run_samples *dst;
+
+		line += buf;
+		if (line.empty() || line.back() != '\n')
+			continue;
+
+		if (!json_get_string(line.c_str(), "commit", &commit) ||
+		    (!commit_matches(commit, base) && !commit_matches(commit, head))) {
+			line.clear();
+			continue;
+		}
+		json_get_object(line.c_str(), "config", &config);
+		json_get_string(line.c_str(), "cpu", &cpu);
+		json_get_string(line.c_str(), "renderer", &renderer);
+
+		for (auto &s : *setups) {
+			if (s.config == config && s.cpu == cpu && s.renderer == renderer)
+				setup = &s;
+		}
+		if (setup == NULL) {
+			setups->push_back({ config, cpu, renderer, {}, {} });
+			setup = &(setups->back());
+		}
+
+		dst = commit_matches(commit, base) ? &(setup->base) : &(setup->head);
+		dst->frame_us.emplace_back();
+		dst->gpu_us.emplace_back();
+		json_get_array(line.c_str(), "frame_us", &(dst->frame_us.back()));
+		json_get_array(line.c_str(), "gpu_us", &(dst->gpu_us.back()));
+		line.clear();
+	}
+	fclose(f);
+out:
+	return rv;
+}
+
+static float median(std::vector<float> &v)
+{
+	std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+	return v[v.size() / 2];
+}
+
+static std::vector<float> all_samples(const std::vector<std::vector<float> > &runs)
+{
+	std::vector<float> all;
+
+	for (const auto &r : runs)
+		all.insert(all.end(), r.begin(), r.end());
+	return all;
+}
+
+// Blocks are drawn from each run separately, as many frames as it has
+static void block_resample(const std::vector<std::vector<float> > &runs,
+                           std::vector<float> &dst, std::minstd_rand &gen)
+{
+	dst.clear();
+	for (const auto &r : runs) {
+		size_t blen = std::min((size_t)BOOTSTRAP_BLOCK_LEN, r.size());
+		size_t end = dst.size() + r.size();
+
+		if (r.empty())
+			continue;
+
+		std::uniform_int_distribution<size_t> start(0, r.size() - blen);
+		while (dst.size() < end) {
+			size_t s = start(gen);
+			dst.insert(dst.end(), r.begin() + s, r.begin() + s + blen);
+		}
+		dst.resize(end);
+	}
+}
+
+// Confidence interval of the relative change in median, head vs base
+static void bootstrap_ci(const std::vector<std::vector<float> > &base,
+                         const std::vector<std::vector<float> > &head, float *lo, float *hi)
+{
+	std::minstd_rand gen(1);
+	std::vector<float> rb, rh;
+	std::vector<float> change(BENCH_BOOTSTRAP_ROUNDS);
+	float tail = 0.5f * (1.0f - BENCH_CONFIDENCE);
+
+	for (int i = 0; i < BENCH_BOOTSTRAP_ROUNDS; i++) {
+		block_resample(base, rb, gen);
+		block_resample(head, rh, gen);
+		change[i] = median(rh) / median(rb) - 1.0f;
+	}
+	std::sort(change.begin(), change.end());
+	*lo = change[(size_t)(tail * (BENCH_BOOTSTRAP_ROUNDS - 1))];
+	*hi = change[(size_t)((1.0f - tail) * (BENCH_BOOTSTRAP_ROUNDS - 1))];
+}
+
+static bool compare_metric(const char *name, const std::vector<std::vector<float> > &base_runs,
+                           const std::vector<std::vector<float> > &head_runs, float threshold)
+{
+	std::vector<float> base = all_samples(base_runs), head = all_samples(head_runs);
+	float lo, hi, change;
+	const char *verdict;
+	bool regressed = false;
+
+	if (base.empty() || head.empty()) {
+		printf("%-10s no samples\n", name);
+		return false;
+	}
+
+	bootstrap_ci(base_runs, head_runs, &lo, &hi);
+	change = median(head) / median(base) - 1.0f;
+
+	if (lo > threshold) {
+		verdict = "REGRESSION";
+		regressed = true;
+	} else if (hi < -threshold) {
+		verdict = "improvement";
+	} else {
+		verdict = "no significant change";
+	}
+	printf("%-10s %10.1f %10.1f %+7.1f%%   [%+6.1f%%, %+6.1f%%]   %s\n",
+	       name, median(base), median(head), change * 100.0f,
+	       lo * 100.0f, hi * 100.0f, verdict);
+	return regressed;
+}
+
+int bench_compare(const char *fn, const char *base, const char *head, float threshold)
+{
+	std::vector<struct setup_samples> setups;
+	size_t base_runs = 0, head_runs = 0;
+	unsigned compared = 0;
+	bool regressed = false;
+
+	if (read_samples(fn, base, head, &setups) != 0)
+		return 1;
+
+	for (const auto &s : setups) {
+		base_runs += s.base.frame_us.size();
+		head_runs += s.head.frame_us.size();
+	}
+	if (base_runs == 0 || head_runs == 0) {
+		fprintf(stderr, "No runs of %s found in %s\n", base_runs == 0 ? base : head, fn);
+		return 1;
+	}
+
+	// Runs made with different settings, CPUs or renderers say nothing
+	// about the commits, so only the ones with a counterpart are compared
+	for (const auto &s : setups) {
+		if (s.base.frame_us.empty() || s.head.frame_us.empty()) {
+			fprintf(stderr, "Skipping %zu runs of %s without a counterpart of %s: %s on %s, %s\n",
+			        s.base.frame_us.size() + s.head.frame_us.size(),
+			        s.base.frame_us.empty() ? head : base, s.base.frame_us.empty() ? base : head,
+			        s.config.c_str(), s.renderer.c_str(), s.cpu.c_str());
+			continue;
+		}
+
+		if (compared > 0)
+			printf("\n");
+		printf("%s on %s, %s\n", s.config.c_str(), s.renderer.c_str(), s.cpu.c_str());
+		printf("base %s: %zu runs, head %s: %zu runs\n", base, s.base.frame_us.size(),
+		       head, s.head.frame_us.size());
+		printf("%-10s %10s %10s %8s   %-18s   %s\n", "median us", "base", "head",
+		       "change", "95% CI", "verdict");
+		regressed |= compare_metric("frame", s.base.frame_us, s.head.frame_us, threshold);
+		regressed |= compare_metric("gpu", s.base.gpu_us, s.head.gpu_us, threshold);
+		compared++;
+	}
+
+	if (compared == 0) {
+		fprintf(stderr, "No runs of %s and %s in %s were made with the same settings, CPU and renderer\n",
+		        base, head, fn);
+		return 1;
+	}
+	return regressed ? 2 : 0;
+}
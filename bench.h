@@ -0,0 +1,59 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+
+#define BENCH_DEFAULT_RESULTS "ph_bench.jsonl"
+#define BENCH_DEFAULT_WARMUP 120
+
+// Regressions smaller than this (relative to base) are not reported even
+// if they are statistically significant
+#define BENCH_DEFAULT_THRESHOLD 0.02f
+
+#define BENCH_BOOTSTRAP_ROUNDS 2000
+#define BENCH_CONFIDENCE 0.95f
+
+struct bench_config {
+	unsigned frames;
+	unsigned warmup;
+	unsigned num_balls;
+	unsigned width, height;
+	unsigned seed;
+	unsigned frames_in_flight;
+	float tail_critical_value;
+	float friction;
+	bool compute;
+};
+
+struct bench_run {
+	struct bench_config config;
+	std::string commit;
+	std::string cpu;
+	std::string renderer;
+	std::string gl_version;
+	unsigned frames_seen;
+	std::vector<float> frame_us;
+	std::vector<float> gpu_us;
+};
+
+void bench_run_init(struct bench_run *run, const struct bench_config *config);
+
+// Returns true once the configured number of frames has been recorded
+bool bench_add_frame(struct bench_run *run, float frame_us);
+void bench_add_gpu_time(struct bench_run *run, float gpu_us);
+
+std::string bench_cpu_model(void);
+std::string bench_run_to_json(const struct bench_run *run);
+
+// The results file is append only, one run per line
+int bench_append_result(const char *fn, const std::string &json);
+
+// Compares the runs of commit base against the runs of commit head (prefixes
+// are accepted, but do not match -dirty trees) made with the same config on
+// the same CPU and renderer. Returns 0 if there are no regressions, 1 on
+// errors or if no runs are comparable and 2 if something got significantly
+// slower
+int bench_compare(const char *fn, const char *base, const char *head, float threshold);
+
+#endif
@@ -0,0 +1,32 @@
+# Writes OUT, a header with the contents of every file in SHADERS (a comma
+# separated list of names relative to SRC_DIR) as string constants, and a
+# table to look them up by name
+string(REPLACE "," ";" SHADERS "${SHADERS}")
+
+set(content "// Generated from the shader sources by cmake/embed_shaders.cmake\n\n")
+set(table "")
+foreach(name ${SHADERS})
+	file(READ ${SRC_DIR}/${name} src)
+	string(MAKE_C_IDENTIFIER ${name} ident)
+	string(FIND "${src}" ")glsl\"" clash)
+	if(NOT clash EQUAL -1)
+		message(FATAL_ERROR "${name} contains the raw string delimiter")
+	endif()
+	string(APPEND content "static constexpr const char ${ident}[] = R\"glsl(${src})glsl\";\n\n")
+	string(APPEND table "\t{ \"${name}\", ${ident}, sizeof(${ident}) - 1 },\n")
+endforeach()
+
+string(APPEND content "struct embedded_shader {\n"
+                      "\tconst char *name;\n"
+                      "\tconst char *src;\n"
+                      "\tsize_t len;\n"
+                      "};\n\n"
+                      "static constexpr struct embedded_shader embedded_shaders[] = {\n"
+                      "${table}};\n")
+
+if(EXISTS ${OUT})
+	file(READ ${OUT} old)
+endif()
+if(NOT "${old}" STREQUAL "${content}")
+	file(WRITE ${OUT} "${content}")
+endif()
@@ -0,0 +1,29 @@
+# Writes OUT with the commit the sources are at. Runs on every build but only
+# touches OUT when the commit changes, so it does not force recompiles
+execute_process(
+	COMMAND git rev-parse --short=12 HEAD
+	WORKING_DIRECTORY ${SRC_DIR}
+	OUTPUT_VARIABLE commit
+	OUTPUT_STRIP_TRAILING_WHITESPACE
+	RESULT_VARIABLE res
+	ERROR_QUIET)
+if(NOT res EQUAL 0)
+	set(commit "unknown")
+else()
+	execute_process(
+		COMMAND git diff --quiet HEAD
+		WORKING_DIRECTORY ${SRC_DIR}
+		RESULT_VARIABLE dirty
+		ERROR_QUIET)
+	if(dirty EQUAL 1)
+		set(commit "${commit}-dirty")
+	endif()
+endif()
+
+set(content "#define PH_GIT_COMMIT \"${commit}\"\n")
+if(EXISTS ${OUT})
+	file(READ ${OUT} old)
+endif()
+if(NOT "${old}" STREQUAL "${content}")
+	file(WRITE ${OUT} "${content}")
+endif()
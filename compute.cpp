@@ -0,0 +1,48 @@
+#include "compute.h"
+
+void compute_renderer_init(struct compute_renderer *cr)
+{
+	cr->tex = 0;
+	cr->width = 0;
+	cr->height = 0;
+	glGenFramebuffers(1, &(cr->fbo));
+}
+
+void compute_renderer_destroy(struct compute_renderer *cr)
+{
+	glDeleteFramebuffers(1, &(cr->fbo));
+	glDeleteTextures(1, &(cr->tex));
+}
+
+// The texture has immutable storage, so a new size takes a new texture
+static void resize(struct compute_renderer *cr, int width, int height)
+{
+	glDeleteTextures(1, &(cr->tex));
+	glGenTextures(1, &(cr->tex));
+	glBindTexture(GL_TEXTURE_2D, cr->tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, cr->fbo);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cr->tex, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	cr->width = width;
+	cr->height = height;
+}
+
+void compute_renderer_draw(struct compute_renderer *cr, GLuint prg, int width, int height)
+{
+	if (width != cr->width || height != cr->height)
+		resize(cr, width, height);
+
+	glUseProgram(prg);
+	glBindImageTexture(COMPUTE_IMAGE_BINDING, cr->tex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	glDispatchCompute((width + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE,
+	                  (height + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE, 1);
+
+	// The blit reads the image through a framebuffer attachment
+	glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, cr->fbo);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,28 @@
+#ifndef COMPUTE_H
+#define COMPUTE_H
+
+#include <GL/glew.h>
+
+// Work group size of field_cs.glsl, one group per tile of this many pixels
+// square
+#define COMPUTE_TILE_SIZE 16
+
+// Image unit field_cs.glsl writes to
+#define COMPUTE_IMAGE_BINDING 0
+
+// Draws the balls with field_cs.glsl into an image and blits that to the
+// draw framebuffer
+struct compute_renderer {
+	GLuint tex;
+	GLuint fbo; // Read framebuffer for the blit
+	int width, height;
+};
+
+void compute_renderer_init(struct compute_renderer *cr);
+void compute_renderer_destroy(struct compute_renderer *cr);
+
+// prg is built from field_cs.glsl, with its uniforms already set. Draws to
+// the lower left width x height pixels of whatever framebuffer is bound
+void compute_renderer_draw(struct compute_renderer *cr, GLuint prg, int width, int height);
+
+#endif
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+
+#include "cpushade.h"
+
+#define PI 3.14159f
+#define WARP_FACTOR 70.0f
+
+#ifdef __FLT16_MANT_DIG__
+typedef _Float16 half;
+#else
+// A float kept at half precision. Each sum, difference and product is
+// computed in float and rounded to half once, like _Float16 rounds once per
+// operation. Products of two halves are exact in float, but sums of two with
+// far apart exponents are not, so those are rounded twice and may rarely
+// come out one ulp off
+struct half {
+	float f;
+
+	half() {}
+	half(float x) : f(round_half(x)) {}
+	operator float() const { return f; }
+
+	half &operator+=(half b) { return *this = half(f + b.f); }
+
+	// Nearest even at 11 significant bits, or at steps of 2^-24 for the
+	// subnormals below 2^-14. Colors never get near the top of the range
+	static float round_half(float x)
+	{
+		int e;
+
+		if (std::abs(x) < std::ldexp(1.0f, -14))
+			return std::ldexp(std::nearbyint(std::ldexp(x, 24)), -24);
+		std::frexp(x, &e);
+		return std::ldexp(std::nearbyint(std::ldexp(x, 11 - e)), e - 11);
+	}
+};
+
+static half operator+(half a, half b) { return half(a.f + b.f); }
+static half operator-(half a, half b) { return half(a.f - b.f); }
+static half operator*(half a, half b) { return half(a.f * b.f); }
+#endif
+
+template <typename T> static T clamp(T x, T lo, T hi)
+{
+	return std::min(std::max(x, lo), hi);
+}
+
+template <typename T> static T fract(T x)
+{
+	return x - (T)std::floor((float)x);
+}
+
+template <typename T> static T mix(T a, T b, T t)
+{
+	return a * ((T)1.0f - t) + b * t;
+}
+
+static float smoothstep(float lo, float hi, float x)
+{
+	float t = clamp((x - lo) / (hi - lo), 0.0f, 1.0f);
+
+	return t * t * (3.0f - 2.0f * t);
+}
+
+static float vec_angle(float dx, float dy)
+{
+	float xsign = dx > 0.0f ? 1.0f : (dx < 0.0f ? -1.0f : 0.0f);
+
+	dx = std::max(std::abs(dx), 1e-6f) * xsign;
+	return std::atan2(dy, dx);
+}
+
+static float star_func(float ang, float num_points, float plumpness)
+{
+	float inv_plump = 1.0f - plumpness;
+
+	return (1.0f - std::pow(std::cos(ang * num_points * 0.5f), 2.0f)) * inv_plump + plumpness;
+}
+
+template <typename T> static void hsv2rgb(const GLfloat *hsv, T rgb[3])
+{
+	const T K[4] = { (T)1.0f, (T)(2.0f / 3.0f), (T)(1.0f / 3.0f), (T)3.0f };
+	T h = (T)hsv[0], s = (T)hsv[1], v = (T)hsv[2];
+
+	for (int c = 0; c < 3; c++) {
+		T p = (T)std::abs((float)(fract<T>(h + K[c]) * (T)6.0f - K[3]));
+		rgb[c] = v * mix<T>(K[0], clamp<T>(p - K[0], (T)0.0f, (T)1.0f), s);
+	}
+}
+
+// T is the type of the color math, the field is always in float
+template <typename T> static void shade(const struct cpushade_scene *s, float u, float v, float out[3])
+{
+	T color[3] = { (T)0.0f, (T)0.0f, (T)0.0f };
+	T saturation = (T)0.0f;
+	float x = u * s->aspect_ratio;
+
+	for (GLuint i = 0; i < s->num_balls; i++) {
+		const GLfloat *pos_rad = s->pos_rad + i * 3;
+		const GLfloat *params = s->params + i * 4;
+		float dx = x - pos_rad[0], dy = v - pos_rad[1];
+		float dist_sqrd = dx * dx + dy * dy;
+		float warp_ang = PI * params[3] * dist_sqrd * WARP_FACTOR;
+		float ang = vec_angle(dx, dy) + params[1] + warp_ang;
+		float r = pos_rad[2] * star_func(ang, params[0], params[2]);
+		float field_str = r * r / dist_sqrd;
+		float field_clamped = std::min(1.0f, field_str * smoothstep(s->tail_critical_value,
+		                                                            1.0f, field_str));
+		T curr_color[3];
+
+		hsv2rgb<T>(s->color + i * 3, curr_color);
+		for (int c = 0; c < 3; c++)
+			color[c] += (T)field_clamped * curr_color[c];
+		saturation += (T)field_clamped;
+	}
+
+	saturation = clamp<T>(saturation, (T)0.0f, (T)1.0f);
+	for (int c = 0; c < 3; c++)
+		out[c] = (float)(clamp<T>(color[c], (T)0.0f, (T)1.0f) + ((T)1.0f - saturation));
+}
+
+void cpushade(const struct cpushade_scene *s, float u, float v, float rgb[3])
+{
+	shade<float>(s, u, v, rgb);
+}
+
+void cpushade_half(const struct cpushade_scene *s, float u, float v, float rgb[3])
+{
+	shade<half>(s, u, v, rgb);
+}
+
+// What the RGBA8 framebuffer would hold
+static int level(float f)
+{
+	return (int)std::lround(clamp(f, 0.0f, 1.0f) * 255.0f);
+}
+
+void cpushade_compare(const struct cpushade_scene *s, int width, int height,
+                      struct cpushade_error *err)
+{
+	float rgb32[3], rgb16[3];
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float u = ((float)x + 0.5f) / (float)width;
+			float v = ((float)y + 0.5f) / (float)height;
+
+			cpushade(s, u, v, rgb32);
+			cpushade_half(s, u, v, rgb16);
+			for (int c = 0; c < 3; c++) {
+				double e = std::abs((double)rgb32[c] - (double)rgb16[c]) * 255.0;
+
+				err->max = std::max(err->max, e);
+				err->sum += e;
+				err->changed += level(rgb32[c]) != level(rgb16[c]);
+			}
+			err->channels += 3;
+		}
+	}
+}
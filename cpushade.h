@@ -0,0 +1,41 @@
+#ifndef CPUSHADE_H
+#define CPUSHADE_H
+
+#include <GL/glew.h>
+
+// Size the scenes are shaded at for the error report
+#define CPUSHADE_REPORT_WIDTH  320
+#define CPUSHADE_REPORT_HEIGHT 180
+
+// A scene as fs.glsl gets it from the uniforms
+struct cpushade_scene {
+	GLuint num_balls;
+	float aspect_ratio;
+	float tail_critical_value;
+	const GLfloat *pos_rad; // xyz per ball
+	const GLfloat *color;   // HSV per ball
+	const GLfloat *params;  // xyzw per ball
+};
+
+// Color of the scene at uv like shade() in fs.glsl, with the colors mixed in
+// single or in half precision like its HALF variant. Half floats are native
+// where the compiler has _Float16, and rounded to 11 bits after every step
+// elsewhere
+void cpushade(const struct cpushade_scene *s, float u, float v, float rgb[3]);
+void cpushade_half(const struct cpushade_scene *s, float u, float v, float rgb[3]);
+
+// Differences of the half precision colors from the single precision ones,
+// in 8 bit levels, over all channels of all pixels added so far
+struct cpushade_error {
+	double max;
+	double sum;
+	unsigned long long channels;
+	unsigned long long changed; // Channels that come out different as RGBA8
+};
+
+// Shades the scene both ways at width x height pixel centers and adds the
+// differences to err
+void cpushade_compare(const struct cpushade_scene *s, int width, int height,
+                      struct cpushade_error *err);
+
+#endif
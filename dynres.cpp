@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+
+#include "dynres.h"
+
+#define SMOOTHING 0.1f
+
+void dynres_init(struct dynres *d, bool enabled)
+{
+	d->enabled = enabled;
+	d->scale = DYNRES_MAX_SCALE;
+	d->avg_gpu_us = 0.0f;
+	d->out_fbo = 0;
+	d->prg = 0;
+	d->tex = 0;
+	d->fb_width = 0;
+	d->fb_height = 0;
+	d->width = 0;
+	d->height = 0;
+	glGenFramebuffers(1, &(d->fbo));
+	glGenVertexArrays(1, &(d->vao));
+}
+
+void dynres_destroy(struct dynres *d)
+{
+	glDeleteVertexArrays(1, &(d->vao));
+	glDeleteFramebuffers(1, &(d->fbo));
+	glDeleteTextures(1, &(d->tex));
+	glDeleteProgram(d->prg);
+}
+
+void dynres_set_program(struct dynres *d, GLuint prg)
+{
+	glDeleteProgram(d->prg);
+	d->prg = prg;
+	d->src_scale_loc = glGetUniformLocation(prg, "src_scale");
+	glProgramUniform1i(prg, glGetUniformLocation(prg, "src"), 0);
+}
+
+void dynres_update(struct dynres *d, float gpu_us, float budget_us)
+{
+	float want;
+
+	if (!d->enabled || gpu_us <= 0.0f)
+		return;
+
+	if (d->avg_gpu_us == 0.0f)
+		d->avg_gpu_us = gpu_us;
+	else
+		d->avg_gpu_us += (gpu_us - d->avg_gpu_us) * SMOOTHING;
+
+	// GPU time goes roughly with the pixel count, the square of the scale
+	want = d->scale * std::sqrt(DYNRES_TARGET_LOAD * budget_us / d->avg_gpu_us);
+	want = std::max(std::min(want, DYNRES_MAX_SCALE), DYNRES_MIN_SCALE);
+	if (std::abs(want - d->scale) < DYNRES_STEP &&
+	    want != DYNRES_MAX_SCALE && want != DYNRES_MIN_SCALE)
+		return;
+
+	// Until frames at the new scale come in, assume they will take what
+	// the pixel count says
+	d->avg_gpu_us *= (want * want) / (d->scale * d->scale);
+	d->scale = want;
+}
+
+static void resize(struct dynres *d, int fb_width, int fb_height)
+{
+	glDeleteTextures(1, &(d->tex));
+	glGenTextures(1, &(d->tex));
+	glBindTexture(GL_TEXTURE_2D, d->tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, fb_width, fb_height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, d->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, d->tex, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	d->fb_width = fb_width;
+	d->fb_height = fb_height;
+}
+
+void dynres_begin(struct dynres *d, int fb_width, int fb_height, int *width, int *height)
+{
+	if (!d->enabled || d->prg == 0 || d->scale >= DYNRES_MAX_SCALE) {
+		d->width = 0;
+		d->height = 0;
+		*width = fb_width;
+		*height = fb_height;
+		glBindFramebuffer(GL_FRAMEBUFFER, d->out_fbo);
+		glViewport(0, 0, fb_width, fb_height);
+		return;
+	}
+
+	if (fb_width != d->fb_width || fb_height != d->fb_height)
+		resize(d, fb_width, fb_height);
+
+	d->width  = std::max((int)(fb_width  * d->scale + 0.5f), 1);
+	d->height = std::max((int)(fb_height * d->scale + 0.5f), 1);
+	*width = d->width;
+	*height = d->height;
+	glBindFramebuffer(GL_FRAMEBUFFER, d->fbo);
+	glViewport(0, 0, d->width, d->height);
+}
+
+void dynres_end(struct dynres *d)
+{
+	if (d->width == 0)
+		return;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, d->out_fbo);
+	glViewport(0, 0, d->fb_width, d->fb_height);
+	glUseProgram(d->prg);
+	glProgramUniform2f(d->prg, d->src_scale_loc, (float)d->width / d->fb_width,
+	                   (float)d->height / d->fb_height);
+	glBindTexture(GL_TEXTURE_2D, d->tex);
+	glBindVertexArray(d->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+}
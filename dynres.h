@@ -0,0 +1,58 @@
+#ifndef DYNRES_H
+#define DYNRES_H
+
+#include <GL/glew.h>
+
+// Range of the render scale, per axis
+#define DYNRES_MIN_SCALE 0.5f
+#define DYNRES_MAX_SCALE 1.0f
+
+// Share of the frame budget the GPU should be busy for. Leaves room for
+// the frames that take longer than average
+#define DYNRES_TARGET_LOAD 0.8f
+
+// Scale changes smaller than this are ignored, so the resolution does not
+// hop around with every frame
+#define DYNRES_STEP 0.05f
+
+// Renders the field offscreen at a fraction of the framebuffer resolution
+// and upscales it with upscale_fs.glsl. The scale follows the GPU time, so
+// that the GPU stays within the frame budget
+struct dynres {
+	bool enabled;
+	float scale;
+	float avg_gpu_us;
+
+	// Where the field ends up, the default framebuffer unless recording
+	GLuint out_fbo;
+
+	GLuint prg;
+	GLint src_scale_loc;
+	GLuint vao;
+
+	// Allocated at the framebuffer size, the field only uses the lower
+	// left corner of it
+	GLuint tex;
+	GLuint fbo;
+	int fb_width, fb_height;
+	int width, height; // Of the part in use this frame
+};
+
+void dynres_init(struct dynres *d, bool enabled);
+void dynres_destroy(struct dynres *d);
+
+// Takes ownership of prg, which should be built from vs.glsl and upscale_fs.glsl.
+// Until there is one, the field is drawn at full resolution
+void dynres_set_program(struct dynres *d, GLuint prg);
+
+// Feeds in the GPU time of a frame, budget_us is the time between refreshes
+void dynres_update(struct dynres *d, float gpu_us, float budget_us);
+
+// Binds the framebuffer to draw the field into and sets the viewport to its
+// size, which is also returned
+void dynres_begin(struct dynres *d, int fb_width, int fb_height, int *width, int *height);
+
+// Upscales the field to out_fbo, if it was drawn offscreen
+void dynres_end(struct dynres *d);
+
+#endif
@@ -0,0 +1,121 @@
+#include "edge_aa.h"
+
+void edge_aa_init(struct edge_aa *aa)
+{
+	aa->mark_prg = 0;
+	aa->tex = 0;
+	aa->stencil = 0;
+	aa->fb_width = 0;
+	aa->fb_height = 0;
+	aa->out_fbo = 0;
+	aa->width = 0;
+	aa->height = 0;
+	glGenFramebuffers(1, &(aa->fbo));
+	glGenFramebuffers(1, &(aa->mark_fbo));
+	glGenVertexArrays(1, &(aa->vao));
+}
+
+void edge_aa_destroy(struct edge_aa *aa)
+{
+	glDeleteVertexArrays(1, &(aa->vao));
+	glDeleteFramebuffers(1, &(aa->mark_fbo));
+	glDeleteFramebuffers(1, &(aa->fbo));
+	glDeleteRenderbuffers(1, &(aa->stencil));
+	glDeleteTextures(1, &(aa->tex));
+	glDeleteProgram(aa->mark_prg);
+}
+
+void edge_aa_set_program(struct edge_aa *aa, GLuint prg)
+{
+	glDeleteProgram(aa->mark_prg);
+	aa->mark_prg = prg;
+	glProgramUniform1i(prg, glGetUniformLocation(prg, "src"), 0);
+}
+
+static void resize(struct edge_aa *aa, int width, int height)
+{
+	glDeleteTextures(1, &(aa->tex));
+	glGenTextures(1, &(aa->tex));
+	glBindTexture(GL_TEXTURE_2D, aa->tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glDeleteRenderbuffers(1, &(aa->stencil));
+	glGenRenderbuffers(1, &(aa->stencil));
+	glBindRenderbuffer(GL_RENDERBUFFER, aa->stencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, aa->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, aa->tex, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, aa->stencil);
+	glBindFramebuffer(GL_FRAMEBUFFER, aa->mark_fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, aa->stencil);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	aa->fb_width = width;
+	aa->fb_height = height;
+}
+
+void edge_aa_begin(struct edge_aa *aa, int width, int height, bool active)
+{
+	GLint out_fbo;
+
+	if (aa->mark_prg == 0 || !active) {
+		aa->width = 0;
+		aa->height = 0;
+		return;
+	}
+
+	// Before resize, which unbinds it
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &out_fbo);
+	aa->out_fbo = out_fbo;
+
+	// Only grows, dynamic resolution changes the size all the time
+	if (width > aa->fb_width || height > aa->fb_height)
+		resize(aa, width > aa->fb_width ? width : aa->fb_width,
+		       height > aa->fb_height ? height : aa->fb_height);
+
+	aa->width = width;
+	aa->height = height;
+	glBindFramebuffer(GL_FRAMEBUFFER, aa->fbo);
+	glClear(GL_STENCIL_BUFFER_BIT);
+}
+
+void edge_aa_end(struct edge_aa *aa, GLuint prg, GLint aa_pass_loc)
+{
+	if (aa->width == 0)
+		return;
+
+	if (aa_pass_loc >= 0) {
+		// Stencil 1 wherever the first pass left a flag
+		glEnable(GL_STENCIL_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, aa->mark_fbo);
+		glStencilFunc(GL_ALWAYS, 1, 0xff);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+		glUseProgram(aa->mark_prg);
+		glBindTexture(GL_TEXTURE_2D, aa->tex);
+		glBindVertexArray(aa->vao);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+
+		// The stencil test comes before the fragment shader, so the
+		// other pixels are never shaded again
+		glBindFramebuffer(GL_FRAMEBUFFER, aa->fbo);
+		glStencilFunc(GL_EQUAL, 1, 0xff);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		glUseProgram(prg);
+		glProgramUniform1i(prg, aa_pass_loc, 1);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		glProgramUniform1i(prg, aa_pass_loc, 0);
+		glDisable(GL_STENCIL_TEST);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, aa->fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, aa->out_fbo);
+	glBlitFramebuffer(0, 0, aa->width, aa->height, 0, 0, aa->width, aa->height,
+	                  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, aa->out_fbo);
+}
@@ -0,0 +1,49 @@
+#ifndef EDGE_AA_H
+#define EDGE_AA_H
+
+#include <GL/glew.h>
+
+// Samples per flagged pixel in the second pass are the square of this. In
+// fs.glsl as AA_GRID
+#define EDGE_AA_GRID 4
+
+// Antialiasing of the ball edges that only pays for the pixels on them. The
+// EDGE_AA variant of fs.glsl draws the field at one sample per pixel and
+// flags pixels at a ball's cutoff or with steep color changes in alpha.
+// edge_aa_mark_fs.glsl turns the flags into stencil, and the same program
+// then shades only the flagged pixels again with more samples
+struct edge_aa {
+	GLuint mark_prg;
+	GLuint vao;
+
+	// The field is drawn here and then blitted to whatever framebuffer was
+	// bound at begin. The mark pass draws to mark_fbo, which only has the
+	// stencil, since it reads the color
+	GLuint tex;
+	GLuint stencil;
+	GLuint fbo;
+	GLuint mark_fbo;
+	int fb_width, fb_height;
+
+	GLuint out_fbo;
+	int width, height; // Of the part in use this frame, 0 if not active
+};
+
+void edge_aa_init(struct edge_aa *aa);
+void edge_aa_destroy(struct edge_aa *aa);
+
+// Takes ownership of prg, which should be built from vs.glsl and
+// edge_aa_mark_fs.glsl. Until there is one, nothing is antialiased
+void edge_aa_set_program(struct edge_aa *aa, GLuint prg);
+
+// Called with the framebuffer and viewport the field is about to be drawn
+// to bound. If active, binds the offscreen framebuffer instead. Inactive
+// while switched off, and for renderers that do not draw with fs.glsl
+void edge_aa_begin(struct edge_aa *aa, int width, int height, bool active);
+
+// prg is the program the field was drawn with and aa_pass_loc its aa_pass
+// uniform, -1 if it is not an EDGE_AA variant. Shades the flagged pixels
+// again and blits the field to where it was meant to go
+void edge_aa_end(struct edge_aa *aa, GLuint prg, GLint aa_pass_loc);
+
+#endif
@@ -0,0 +1,12 @@
+#version 460
+
+// Marks the pixels the EDGE_AA variant of fs.glsl flagged, by leaving only
+// them to the stencil write. See edge_aa.h
+
+uniform sampler2D src;
+
+void main()
+{
+	if (texelFetch(src, ivec2(gl_FragCoord.xy), 0).a >= 0.5)
+		discard;
+}
@@ -0,0 +1,40 @@
+#version 460
+
+// Stand-in for fs.glsl while it is still being compiled. Uses the same
+// inputs, but only draws each ball as a flat disc
+
+#define MAX_BALL_COUNT 63
+
+layout (location = 0) out vec4 fragColor;
+
+in vec2 uv;
+
+layout (std140, binding = 0) uniform live_params {
+	float aspect_ratio;
+	float tail_critical_value;
+	uint  debug_mode;
+};
+
+uniform uint  num_balls;
+uniform vec3  ball_pos_rad[MAX_BALL_COUNT];
+uniform vec3  ball_color[MAX_BALL_COUNT];
+
+vec3 hsv2rgb(vec3 c)
+{
+	vec4 K = vec4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);
+	vec3 p = abs(fract(c.xxx + K.xyz) * 6.0 - K.www);
+	return c.z * mix(K.xxx, clamp(p - K.xxx, 0.0, 1.0), c.y);
+}
+
+void main()
+{
+	vec2 uv_corr = vec2(uv.x * aspect_ratio, uv.y);
+	vec3 color = vec3(1.0, 1.0, 1.0);
+
+	for (uint i = 0u; i < num_balls; i++) {
+		vec2 delta_pos = uv_corr - ball_pos_rad[i].xy;
+		if (dot(delta_pos, delta_pos) < ball_pos_rad[i].z * ball_pos_rad[i].z)
+			color = hsv2rgb(ball_color[i]);
+	}
+	fragColor = vec4(color, 1.0);
+}
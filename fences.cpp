@@ -0,0 +1,64 @@
+#include <chrono>
+
+#include "fences.h"
+
+// Checked again after this long in case the context got lost or the like
+#define WAIT_TIMEOUT_NS 100000000ull
+
+void frame_fences_init(struct frame_fences *f, GLuint depth)
+{
+	if (depth < MIN_FRAMES_IN_FLIGHT)
+		depth = MIN_FRAMES_IN_FLIGHT;
+	if (depth > MAX_FRAMES_IN_FLIGHT)
+		depth = MAX_FRAMES_IN_FLIGHT;
+
+	f->depth = depth;
+	for (GLuint i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		f->fences[i] = 0;
+	f->frame = 0;
+	f->completed = 0;
+	f->wait_us = 0.0f;
+	f->total_wait_us = 0.0;
+}
+
+void frame_fences_destroy(struct frame_fences *f)
+{
+	for (GLuint i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (f->fences[i] != 0)
+			glDeleteSync(f->fences[i]);
+	}
+}
+
+GLuint frame_fences_wait(struct frame_fences *f)
+{
+	GLuint slot = f->frame % f->depth;
+	GLsync fence = f->fences[slot];
+	GLenum status;
+
+	f->wait_us = 0.0f;
+	if (f->frame >= f->depth)
+		f->completed = f->frame - f->depth + 1;
+	if (fence == 0)
+		return slot;
+
+	auto start = std::chrono::steady_clock::now();
+	do {
+		status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT_NS);
+	} while (status == GL_TIMEOUT_EXPIRED);
+	auto end = std::chrono::steady_clock::now();
+
+	glDeleteSync(fence);
+	f->fences[slot] = 0;
+
+	f->wait_us = std::chrono::duration<float, std::micro>(end - start).count();
+	f->total_wait_us += f->wait_us;
+	return slot;
+}
+
+void frame_fences_submit(struct frame_fences *f)
+{
+	GLuint slot = f->frame % f->depth;
+
+	f->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	f->frame++;
+}
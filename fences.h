@@ -0,0 +1,33 @@
+#ifndef FENCES_H
+#define FENCES_H
+
+#include <GL/glew.h>
+
+#define MIN_FRAMES_IN_FLIGHT 1
+#define MAX_FRAMES_IN_FLIGHT 3
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+
+// Keeps the driver from queueing more than depth frames. Deeper queues give
+// the GPU more slack but every queued frame is a frame of input latency
+struct frame_fences {
+	GLuint depth;
+	GLsync fences[MAX_FRAMES_IN_FLIGHT];
+	GLuint64 frame;     // Frames submitted so far
+	GLuint64 completed; // Frames the GPU is known to have finished
+
+	float wait_us; // How long the latest frame_fences_wait blocked
+	double total_wait_us;
+};
+
+void frame_fences_init(struct frame_fences *f, GLuint depth);
+void frame_fences_destroy(struct frame_fences *f);
+
+// Blocks until the GPU has finished the frame submitted depth frames ago.
+// Returns the slot of the frame about to be built, which stays unique among
+// frames in flight, so it can index per frame resources
+GLuint frame_fences_wait(struct frame_fences *f);
+
+// Call after the last GL command of the frame (i.e. the swap)
+void frame_fences_submit(struct frame_fences *f);
+
+#endif
@@ -0,0 +1,166 @@
+#version 460
+
+// Compute version of fs.glsl. Each group first copies the balls that can
+// reach its tile into shared memory, as binned in tile_masks by tilebin.cpp,
+// then every invocation shades its pixel from that list only. The field math
+// has to stay in sync with fs.glsl
+
+#define TILE_SIZE 16 // COMPUTE_TILE_SIZE in compute.h
+#define MAX_BALL_COUNT 63
+#define PI 3.14159
+#define WARP_FACTOR 70.0
+
+#define DEBUG_OFF         0u
+#define DEBUG_CONTRIBUTED 1u
+#define DEBUG_EVALUATED   2u
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+layout (rgba8, binding = 0) uniform writeonly image2D out_image;
+
+layout (std140, binding = 0) uniform live_params {
+	float aspect_ratio;
+	float tail_critical_value;
+	uint  debug_mode;
+};
+
+uniform uint  num_balls;
+uniform vec3  ball_pos_rad[MAX_BALL_COUNT];
+uniform vec3  ball_color[MAX_BALL_COUNT];
+uniform vec4  ball_params[MAX_BALL_COUNT];
+
+layout (std430, binding = 0) buffer shading_counters {
+	uint evaluated_total;
+	uint contributed_total;
+};
+
+// Bit i of a tile is set if ball i can reach it, tiles row by row
+layout (std430, binding = 2) readonly buffer tile_masks {
+	uvec2 masks[];
+};
+
+// Balls that can reach this tile, colors already converted to RGB
+shared vec3 tile_pos_rad[MAX_BALL_COUNT];
+shared vec3 tile_color[MAX_BALL_COUNT];
+shared vec4 tile_params[MAX_BALL_COUNT];
+shared uint tile_num_balls;
+
+float vec_angle(vec2 delta)
+{
+	float xsign = sign(delta.x);
+	float xabs  = abs (delta.x);
+
+	xabs    = max(xabs, 1e-6);
+	delta.x = xabs * xsign;
+	return atan(delta.y, delta.x);
+}
+
+float star_func(float ang, float num_points, float plumpness)
+{
+	float inv_plump = 1.0 - plumpness;
+
+	return (1.0 - pow(cos(ang * num_points * 0.5), 2)) * inv_plump + plumpness;
+}
+
+float falloff(float dist_sqrd, float r)
+{
+	return pow(r, 2) / dist_sqrd;
+}
+
+vec3 hsv2rgb(vec3 c)
+{
+	vec4 K = vec4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);
+	vec3 p = abs(fract(c.xxx + K.xyz) * 6.0 - K.www);
+	return c.z * mix(K.xxx, clamp(p - K.xxx, 0.0, 1.0), c.y);
+}
+
+float kill_tail(float f)
+{
+	return f * smoothstep(tail_critical_value, 1.0, f);
+}
+
+vec3 heat(float t)
+{
+	t = clamp(t, 0.0, 1.0) * 4.0;
+	return clamp(vec3(t - 2.0, min(t - 1.0, 4.0 - t), min(t, 2.0 - t)), 0.0, 1.0);
+}
+
+void main()
+{
+	ivec2 size  = imageSize(out_image);
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+
+	uvec2 mask = masks[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x];
+
+	// The balls keep their order in the list, so the colors are always
+	// summed in the same order and the output is the same every run. The
+	// slot of a ball is the number of balls before it in the mask
+	if (gl_LocalInvocationIndex == 0u)
+		tile_num_balls = uint(bitCount(mask.x) + bitCount(mask.y));
+
+	for (uint i = gl_LocalInvocationIndex; i < num_balls; i += uint(TILE_SIZE * TILE_SIZE)) {
+		uint below_x = i < 32u ? (1u << i) - 1u : 0xffffffffu;
+		uint below_y = i < 32u ? 0u : (1u << (i - 32u)) - 1u;
+		uint bit = i < 32u ? mask.x & (1u << i) : mask.y & (1u << (i - 32u));
+
+		if (bit != 0u) {
+			uint slot = uint(bitCount(mask.x & below_x) + bitCount(mask.y & below_y));
+			tile_pos_rad[slot] = ball_pos_rad[i];
+			tile_color[slot]   = hsv2rgb(ball_color[i]);
+			tile_params[slot]  = ball_params[i];
+		}
+	}
+	barrier();
+
+	// Only now, every invocation has to reach the barriers
+	if (any(greaterThanEqual(pixel, size)))
+		return;
+
+	vec2 uv = (vec2(pixel) + 0.5) / vec2(size);
+	vec2 uv_corr = vec2(uv.x * aspect_ratio, uv.y);
+
+	vec3 color = vec3(0.0, 0.0, 0.0);
+	float saturation = 0.0;
+	uint contributed = 0u;
+
+	for (uint i = 0u; i < tile_num_balls; i++) {
+		vec2 curr_pos    = tile_pos_rad[i].xy;
+		float curr_r     = tile_pos_rad[i].z;
+		float curr_n_pts = tile_params[i].x;
+		float curr_ang   = tile_params[i].y;
+		float plumpness  = tile_params[i].z;
+		float curr_warp  = tile_params[i].w;
+
+		vec2  delta_pos  = uv_corr - curr_pos;
+		float dist_sqrd  = dot(delta_pos, delta_pos);
+
+		float warp_ang = PI * curr_warp * dist_sqrd * WARP_FACTOR;
+		float scr_ang = vec_angle(delta_pos);
+		float ang = scr_ang + curr_ang + warp_ang;
+		float star_param = star_func(ang, curr_n_pts, plumpness);
+
+		float field_str = falloff(dist_sqrd, curr_r * star_param);
+		float field_clamped = min(1.0, kill_tail(field_str));
+
+		color += field_clamped * tile_color[i];
+		saturation += field_clamped;
+
+		contributed += field_clamped > 0.0 ? 1u : 0u;
+	}
+
+	if (debug_mode != DEBUG_OFF) {
+		atomicAdd(evaluated_total, tile_num_balls);
+		atomicAdd(contributed_total, contributed);
+
+		uint n = debug_mode == DEBUG_CONTRIBUTED ? contributed : tile_num_balls;
+		imageStore(out_image, pixel, vec4(heat(float(n) / float(max(num_balls, 1u))), 1.0));
+		return;
+	}
+	saturation = clamp(saturation, 0.0, 1.0);
+	color = clamp(color, 0.0, 1.0);
+
+	float inv_sat = 1.0 - saturation;
+	vec3 final = color + vec3(inv_sat, inv_sat, inv_sat);
+
+	imageStore(out_image, pixel, vec4(final, 1.0));
+}
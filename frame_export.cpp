@@ -0,0 +1,185 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "frame_export.h"
+
+#define PAGE_SZ 4096
+
+static size_t page_align(size_t sz)
+{
+	return (sz + PAGE_SZ - 1) / PAGE_SZ * PAGE_SZ;
+}
+
+static int listen_on(struct frame_export *e, const char *path)
+{
+	struct sockaddr_un addr = {};
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return 1;
+	}
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	e->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (e->listen_fd < 0)
+		return 1;
+	// A previous run that died leaves its socket behind
+	unlink(path);
+	if (bind(e->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(e->listen_fd, 4) != 0) {
+		close(e->listen_fd);
+		e->listen_fd = -1;
+		return 1;
+	}
+	return 0;
+}
+
+static void release(struct frame_export *e)
+{
+	if (e->listen_fd >= 0) {
+		close(e->listen_fd);
+		unlink(e->path);
+	}
+	if (e->header != NULL)
+		munmap(e->header, e->size);
+	if (e->memfd >= 0)
+		close(e->memfd);
+}
+
+int frame_export_init(struct frame_export *e, const char *path, int width, int height)
+{
+	int rv = 0;
+	size_t frame_size = (size_t)width * height * 4;
+	size_t data_offset = page_align(sizeof(struct frame_export_header));
+	struct frame_export_header *h;
+
+	e->path = path;
+	e->memfd = -1;
+	e->listen_fd = -1;
+	e->header = NULL;
+	e->published = 0;
+	e->dropped = 0;
+	e->size = data_offset + FRAME_EXPORT_SLOTS * page_align(frame_size);
+
+	e->memfd = memfd_create("ph-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (e->memfd < 0 || ftruncate(e->memfd, e->size) != 0)
+		goto out_err;
+	// Readers can map it without worrying about it changing size
+	fcntl(e->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+	h = (struct frame_export_header *)mmap(NULL, e->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	                                       e->memfd, 0);
+	if (h == MAP_FAILED)
+		goto out_err;
+	e->header = h;
+	e->data = (unsigned char *)h + data_offset;
+
+	// The memfd starts out zeroed, so every seq is even and latest is 0
+	h->magic = FRAME_EXPORT_MAGIC;
+	h->version = FRAME_EXPORT_VERSION;
+	h->width = width;
+	h->height = height;
+	h->stride = width * 4;
+	h->num_slots = FRAME_EXPORT_SLOTS;
+	h->frame_size = page_align(frame_size);
+	h->data_offset = data_offset;
+
+	if (listen_on(e, path) != 0)
+		goto out_err;
+	if (readback_init(&(e->readback), width, height) != 0) {
+		readback_destroy(&(e->readback));
+		release(e);
+		rv = 1;
+	}
+	goto out;
+
+out_err:
+	fprintf(stderr, "Failed to export frames at %s: %s\n", path, strerror(errno));
+	release(e);
+	rv = 1;
+out:
+	return rv;
+}
+
+void frame_export_destroy(struct frame_export *e)
+{
+	readback_destroy(&(e->readback));
+	release(e);
+}
+
+static void hand_out_memfd(struct frame_export *e)
+{
+	char byte = 0;
+	char control[CMSG_SPACE(sizeof(int))] = {};
+	struct iovec iov = { &byte, 1 };
+	struct msghdr msg = {};
+	struct cmsghdr *cmsg;
+	int fd;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &(e->memfd), sizeof(int));
+
+	// A reader that does not take it right away just misses out
+	while ((fd = accept4(e->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		close(fd);
+	}
+}
+
+// Seqlock write. Readers check seq before and after copying
+static void publish(struct frame_export *e, const unsigned char *rgba)
+{
+	struct frame_export_header *h = e->header;
+	uint64_t frame = e->published + 1;
+	struct frame_export_slot *slot = &(h->slots[(frame - 1) % FRAME_EXPORT_SLOTS]);
+	unsigned char *dst = e->data + (frame - 1) % FRAME_EXPORT_SLOTS * h->frame_size;
+	uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+	struct timespec ts;
+
+	slot->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	// GL rows go bottom up
+	for (uint32_t y = 0; y < h->height; y++)
+		memcpy(dst + (size_t)y * h->stride, rgba + (size_t)(h->height - 1 - y) * h->stride,
+		       h->stride);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	slot->frame = frame;
+	slot->time_ns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+	slot->seq.store(seq + 2, std::memory_order_release);
+	h->latest.store(frame, std::memory_order_release);
+	e->published = frame;
+}
+
+void frame_export_frame(struct frame_export *e, int fb_width, int fb_height)
+{
+	const unsigned char *rgba;
+
+	while ((rgba = readback_oldest(&(e->readback), false)) != NULL) {
+		publish(e, rgba);
+		readback_release(&(e->readback));
+	}
+	hand_out_memfd(e);
+
+	// The export keeps the size it started with
+	if (fb_width != (int)e->header->width || fb_height != (int)e->header->height)
+		return;
+	if (!readback_start(&(e->readback), 0))
+		e->dropped++;
+}
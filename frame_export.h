@@ -0,0 +1,74 @@
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+#include <GL/glew.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "readback.h"
+
+#define FRAME_EXPORT_MAGIC   0x58454850u // "PHEX"
+#define FRAME_EXPORT_VERSION 1u
+
+// Frames a reader can be behind before the one it is copying gets written
+// over (it notices and drops it)
+#define FRAME_EXPORT_SLOTS 3
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "The shared ring needs lock free 64 bit atomics"
+#endif
+
+// Shared memory layout, for readers too. A reader connects to the export
+// socket and gets a memfd with SCM_RIGHTS, then maps it read only. The
+// frames are RGBA, top row first, the pixels of slot i at data_offset +
+// i * frame_size. To read the latest frame:
+//
+//   f = latest; if f == 0 there is nothing yet
+//   slot = (f - 1) % num_slots
+//   s1 = slots[slot].seq (acquire), retry later if odd
+//   copy the pixels
+//   acquire fence, s2 = slots[slot].seq (relaxed)
+//   if s1 != s2 the copy is torn, drop it
+//
+// The renderer never waits for readers
+struct frame_export_slot {
+	std::atomic<uint64_t> seq; // Odd while the slot is being written
+	uint64_t frame;
+	uint64_t time_ns; // CLOCK_MONOTONIC when the frame was published
+};
+
+struct frame_export_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width, height;
+	uint32_t stride; // Bytes per row
+	uint32_t num_slots;
+	uint64_t frame_size;
+	uint64_t data_offset;
+	std::atomic<uint64_t> latest; // Newest whole frame, counting from 1
+	struct frame_export_slot slots[FRAME_EXPORT_SLOTS];
+};
+
+// Publishes the frames drawn to the default framebuffer to other processes
+struct frame_export {
+	int memfd;
+	int listen_fd;
+	const char *path;
+	size_t size;
+	struct frame_export_header *header;
+	unsigned char *data;
+	struct readback readback;
+	uint64_t published;
+	uint64_t dropped; // Because readback was too far behind
+};
+
+int frame_export_init(struct frame_export *e, const char *path, int width, int height);
+void frame_export_destroy(struct frame_export *e);
+
+// Call after drawing, before the swap. Publishes the frames whose readback
+// has finished, hands the memfd to any new readers and starts reading back
+// this frame. Never waits
+void frame_export_frame(struct frame_export *e, int fb_width, int fb_height);
+
+#endif
@@ -1,15 +1,99 @@
 #version 460
 
+// Specializations, see variants.h. Without them this is the generic program
+#ifndef NUM_BALLS
+#define NUM_BALLS 0
+#endif
+#ifndef STAR_CORNERS
+#define STAR_CORNERS 0
+#endif
+#ifndef WARP
+#define WARP 1
+#endif
+#ifndef ATLAS
+#define ATLAS 0
+#endif
+#ifndef EDGE_AA
+#define EDGE_AA 0
+#endif
+#ifndef HALF
+#define HALF 0
+#endif
+
+// The colors are mixed in half precision if HALF is set and the driver has
+// 16 bit floats with the builtins for them, else in full precision like
+// without it. Any of these extensions has float16_t and f16vec3
+#if HALF
+#extension GL_AMD_gpu_shader_half_float : enable
+#extension GL_NV_gpu_shader5 : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : enable
+#endif
+#if HALF && (defined(GL_AMD_gpu_shader_half_float) || defined(GL_NV_gpu_shader5) || \
+             defined(GL_EXT_shader_explicit_arithmetic_types_float16))
+#define hfloat float16_t
+#define hvec3  f16vec3
+#define hvec4  f16vec4
+#else
+#define hfloat float
+#define hvec3  vec3
+#define hvec4  vec4
+#endif
+
+// Values of CULL
+#define CULL_NONE   0
+#define CULL_RADIUS 1 // Skip balls too far away to get past kill_tail
+#ifndef CULL
+#define CULL CULL_NONE
+#endif
+
+#if NUM_BALLS > 0
+#define MAX_BALL_COUNT NUM_BALLS
+#define BALL_LOOP_COUNT NUM_BALLS
+#else
 #define MAX_BALL_COUNT 63
+#define BALL_LOOP_COUNT num_balls
+#endif
+
+// An atlas takes the balls of each cell from a buffer instead of the uniforms
+#if ATLAS
+#define BALL_POS_RAD(i) atlas_balls[cell_base + (i)].pos_rad.xyz
+#define BALL_COLOR(i)   atlas_balls[cell_base + (i)].color.xyz
+#define BALL_PARAMS(i)  atlas_balls[cell_base + (i)].params
+#else
+#define BALL_POS_RAD(i) ball_pos_rad[i]
+#define BALL_COLOR(i)   ball_color[i]
+#define BALL_PARAMS(i)  ball_params[i]
+#endif
+
 #define PI 3.14159
 #define WARP_FACTOR 70.0
 
+// Edge antialiasing, see edge_aa.h. Pixels are shaded again with AA_GRID^2
+// samples if a ball's field is within EDGE_BAND of the cutoff at the pixel,
+// or if the color changes by more than EDGE_GRADIENT to the next pixel
+#define AA_GRID 4 // EDGE_AA_GRID in edge_aa.h
+#define EDGE_BAND 0.05
+#define EDGE_GRADIENT 0.08
+
+// Values of debug_mode
+#define DEBUG_OFF         0u
+#define DEBUG_CONTRIBUTED 1u // Heatmap of balls that survived kill_tail
+#define DEBUG_EVALUATED   2u // Heatmap of balls the loop looked at
+
 layout (location = 0) out vec4 fragColor;
 
 in vec2 uv;
 
-uniform float aspect_ratio;
-uniform float tail_critical_value;
+// Part of the frame this draw covers, for drawing it in tiles
+uniform vec4 view_rect = vec4(0.0, 0.0, 1.0, 1.0);
+
+// Latched by the CPU right before the draw, see live_params.h
+layout (std140, binding = 0) uniform live_params {
+	float aspect_ratio;
+	float tail_critical_value;
+	uint  debug_mode;
+};
+
 uniform uint  num_balls;
 uniform vec3  ball_pos_rad[MAX_BALL_COUNT];
 uniform vec3  ball_color[MAX_BALL_COUNT];
@@ -20,6 +104,40 @@ uniform vec3  ball_color[MAX_BALL_COUNT];
 // w: warp the star
 uniform vec4  ball_params[MAX_BALL_COUNT];
 
+#if ATLAS
+// See atlas.h. NUM_BALLS balls for every cell
+struct atlas_ball {
+	vec4 pos_rad;
+	vec4 color;
+	vec4 params;
+};
+
+// Binding is ATLAS_BINDING in atlas.h
+layout (std430, binding = 1) readonly buffer atlas {
+	uvec2 atlas_grid; // Columns, rows
+	uint  atlas_cells;
+	atlas_ball atlas_balls[];
+};
+
+uint cell_base; // Of the cell being drawn
+#endif
+
+#if EDGE_AA
+// Set for the second pass
+uniform bool aa_pass = false;
+
+// The second pass relies on the stencil test skipping the pixels that were
+// not flagged, which the buffer writes below could otherwise move after the
+// shader
+layout (early_fragment_tests) in;
+#endif
+
+// Frame totals, only written in the debug modes
+layout (std430, binding = 0) buffer shading_counters {
+	uint evaluated_total;
+	uint contributed_total;
+};
+
 float vec_angle(vec2 delta)
 {
 	float xsign = sign(delta.x);
@@ -43,12 +161,13 @@ float falloff(float dist_sqrd, float r)
 	return pow(r, 2) / dist_sqrd;
 }
 
-// Copied from https://github.com/hughsk/glsl-hsv2rgb
-vec3 hsv2rgb(vec3 c)
+// Copied from https://github.com/hughsk/glsl-hsv2rgb. Mirrored by
+// hsv2rgb in cpushade.cpp
+hvec3 hsv2rgb(hvec3 c)
 {
-	vec4 K = vec4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);
-	vec3 p = abs(fract(c.xxx + K.xyz) * 6.0 - K.www);
-	return c.z * mix(K.xxx, clamp(p - K.xxx, 0.0, 1.0), c.y);
+	hvec4 K = hvec4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);
+	hvec3 p = abs(fract(c.xxx + K.xyz) * hfloat(6.0) - K.www);
+	return c.z * mix(K.xxx, clamp(p - K.xxx, hfloat(0.0), hfloat(1.0)), c.y);
 }
 
 float kill_tail(float f)
@@ -56,28 +175,52 @@ float kill_tail(float f)
 	return f * smoothstep(tail_critical_value, 1.0, f);
 }
 
-void main()
+// Black - blue - green - yellow - red as t goes from 0 to 1
+vec3 heat(float t)
 {
-	vec2 uv_corr = vec2(uv.x * aspect_ratio, uv.y);
+	t = clamp(t, 0.0, 1.0) * 4.0;
+	return clamp(vec3(t - 2.0, min(t - 1.0, 4.0 - t), min(t, 2.0 - t)), 0.0, 1.0);
+}
 
-	float val = 0.0;
+// Color of the scene at frame_uv. Also counts the balls for the debug modes
+// and notes whether any ball is right at its cutoff. Mirrored by shade in
+// cpushade.cpp
+vec3 shade(vec2 frame_uv, inout uint evaluated, inout uint contributed, inout bool near_cutoff)
+{
+	vec2 uv_corr = vec2(frame_uv.x * aspect_ratio, frame_uv.y);
 
-	vec3 color = vec3(0.0, 0.0, 0.0);
-	float saturation = 0.0;
+	hvec3 color = hvec3(0.0, 0.0, 0.0);
+	hfloat saturation = hfloat(0.0);
 
-	for (int i = 0; i < num_balls; i++) {
-		vec2 curr_pos    = ball_pos_rad[i].xy;
-		float curr_r     = ball_pos_rad[i].z * 1.0;
-		vec3 curr_color  = hsv2rgb(ball_color[i]);
-		float curr_n_pts = ball_params[i].x;
-		float curr_ang   = ball_params[i].y;
-		float plumpness  = ball_params[i].z;
-		float curr_warp  = ball_params[i].w;
+	for (uint i = 0u; i < BALL_LOOP_COUNT; i++) {
+		vec2 curr_pos    = BALL_POS_RAD(i).xy;
+		float curr_r     = BALL_POS_RAD(i).z * 1.0;
 
 		vec2  delta_pos  = uv_corr - curr_pos;
 		float dist_sqrd  = dot(delta_pos, delta_pos);
 
+#if CULL == CULL_RADIUS
+		// star_func is at most 1, so the field is at most r^2 / d^2 and
+		// kill_tail zeroes anything at or below tail_critical_value
+		if (dist_sqrd * tail_critical_value >= curr_r * curr_r)
+			continue;
+#endif
+
+		hvec3 curr_color = hsv2rgb(hvec3(BALL_COLOR(i)));
+#if STAR_CORNERS > 0
+		float curr_n_pts = float(STAR_CORNERS);
+#else
+		float curr_n_pts = BALL_PARAMS(i).x;
+#endif
+		float curr_ang   = BALL_PARAMS(i).y;
+		float plumpness  = BALL_PARAMS(i).z;
+
+#if WARP
+		float curr_warp  = BALL_PARAMS(i).w;
 		float warp_ang = PI * curr_warp * dist_sqrd * WARP_FACTOR;
+#else
+		float warp_ang = 0.0;
+#endif
 		float scr_ang = vec_angle(delta_pos);
 		float ang = scr_ang + curr_ang + warp_ang;
 		float star_param = star_func(ang, curr_n_pts, plumpness);
@@ -85,15 +228,81 @@ void main()
 		float field_str = falloff(dist_sqrd, curr_r * star_param);
 		float field_clamped = min(1.0, kill_tail(field_str));
 
-		color += field_clamped * curr_color;
-		saturation += field_clamped;
+		// The field itself needs full precision, d^2 gets tiny near
+		// the center
+		color += hfloat(field_clamped) * curr_color;
+		saturation += hfloat(field_clamped);
+
+		evaluated++;
+		contributed += field_clamped > 0.0 ? 1u : 0u;
+#if EDGE_AA
+		near_cutoff = near_cutoff || (field_str > tail_critical_value &&
+		                              field_str < tail_critical_value * (1.0 + EDGE_BAND));
+#endif
 	}
-	saturation = clamp(saturation, 0.0, 1.0);
-	color = clamp(color, 0.0, 1.0);
 
-	float inv_sat = 1.0 - saturation;
-	vec3 whiteness = vec3(inv_sat, inv_sat, inv_sat);
-	vec3 final = color + whiteness;
+	saturation = clamp(saturation, hfloat(0.0), hfloat(1.0));
+	color = clamp(color, hfloat(0.0), hfloat(1.0));
+
+	hfloat inv_sat = hfloat(1.0) - saturation;
+	hvec3 whiteness = hvec3(inv_sat, inv_sat, inv_sat);
+	return vec3(color + whiteness);
+}
+
+void main()
+{
+	vec2 frame_uv = view_rect.xy + uv * view_rect.zw;
+#if ATLAS
+	// Each cell is a frame of its own. Cells go row by row from the top
+	vec2 grid_uv = frame_uv * vec2(atlas_grid);
+	uvec2 cell_xy = uvec2(grid_uv.x, float(atlas_grid.y) - grid_uv.y);
+	uint cell = cell_xy.y * atlas_grid.x + cell_xy.x;
+
+	if (cell >= atlas_cells) {
+		fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+	cell_base = cell * uint(NUM_BALLS);
+	frame_uv = fract(grid_uv);
+#endif
+
+	uint evaluated = 0u;
+	uint contributed = 0u;
+	bool near_cutoff = false;
+
+#if EDGE_AA
+	// Second pass, only runs on the pixels the first one flagged
+	vec2 pixel = vec2(dFdx(frame_uv.x), dFdy(frame_uv.y));
+	if (aa_pass) {
+		vec3 sum = vec3(0.0);
+		for (int y = 0; y < AA_GRID; y++) {
+			for (int x = 0; x < AA_GRID; x++) {
+				vec2 offset = (vec2(x, y) + 0.5) / float(AA_GRID) - 0.5;
+				sum += shade(frame_uv + offset * pixel, evaluated, contributed, near_cutoff);
+			}
+		}
+		fragColor = vec4(sum / float(AA_GRID * AA_GRID), 1.0);
+		return;
+	}
+#endif
+
+	vec3 final = shade(frame_uv, evaluated, contributed, near_cutoff);
+
+	if (debug_mode != DEBUG_OFF) {
+		atomicAdd(evaluated_total, evaluated);
+		atomicAdd(contributed_total, contributed);
+
+		uint n = debug_mode == DEBUG_CONTRIBUTED ? contributed : evaluated;
+		fragColor = vec4(heat(float(n) / float(max(num_balls, 1u))), 1.0);
+		return;
+	}
 
+#if EDGE_AA
+	// Alpha 0 flags the pixel for the second pass
+	vec3 gradient = fwidth(final);
+	bool edge = near_cutoff || max(gradient.r, max(gradient.g, gradient.b)) > EDGE_GRADIENT;
+	fragColor = vec4(final, edge ? 0.0 : 1.0);
+#else
 	fragColor = vec4(final, 1.0);
+#endif
 }
@@ -0,0 +1,124 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "gldebug.h"
+
+#define KEYWORD_SZ 256
+
+struct perf_keyword {
+	const char *word;
+	enum gl_perf_category category;
+};
+
+// Checked in order against the lowercased message. Drivers word these
+// differently, so this is necessarily a bit of a guess
+static const struct perf_keyword perf_keywords[] = {
+	{ "recompil",   GL_PERF_RECOMPILE },
+	{ "compiled",   GL_PERF_RECOMPILE },
+	{ "variant",    GL_PERF_RECOMPILE },
+	{ "stall",      GL_PERF_IMPLICIT_SYNC },
+	{ "sync",       GL_PERF_IMPLICIT_SYNC },
+	{ "wait",       GL_PERF_IMPLICIT_SYNC },
+	{ "busy",       GL_PERF_IMPLICIT_SYNC },
+	{ "flush",      GL_PERF_IMPLICIT_SYNC },
+	{ "migrat",     GL_PERF_BUFFER_MIGRATION },
+	{ "moved",      GL_PERF_BUFFER_MIGRATION },
+	{ "relocat",    GL_PERF_BUFFER_MIGRATION },
+	{ "video memory", GL_PERF_BUFFER_MIGRATION },
+	{ "system memory", GL_PERF_BUFFER_MIGRATION },
+};
+
+static const char *category_names[GL_PERF_NUM_CATEGORIES] = {
+	"implicit_sync",
+	"recompile",
+	"buffer_migration",
+	"other",
+};
+
+const char *gl_perf_category_name(enum gl_perf_category c)
+{
+	return category_names[c];
+}
+
+static enum gl_perf_category categorize(const GLchar *message, GLsizei length)
+{
+	char lower[KEYWORD_SZ];
+	size_t n = std::min((size_t)length, sizeof(lower) - 1);
+
+	for (size_t i = 0; i < n; i++)
+		lower[i] = tolower((unsigned char)message[i]);
+	lower[n] = '\0';
+
+	for (size_t i = 0; i < sizeof(perf_keywords) / sizeof(perf_keywords[0]); i++) {
+		if (strstr(lower, perf_keywords[i].word) != NULL)
+			return perf_keywords[i].category;
+	}
+	return GL_PERF_OTHER;
+}
+
+static void GLAPIENTRY debug_callback(GLenum /* source */, GLenum type, GLuint /* id */,
+                                      GLenum /* severity */, GLsizei length,
+                                      const GLchar *message, const void *user)
+{
+	struct gl_debug *d = (struct gl_debug *)user;
+	enum gl_perf_category c;
+
+	if (length < 0)
+		length = strlen(message);
+
+	if (type == GL_DEBUG_TYPE_ERROR) {
+		d->total_errors.fetch_add(1, std::memory_order_relaxed);
+		if (d->log)
+			fprintf(stderr, "GL [frame %llu] error: %.*s\n", d->frame, (int)length, message);
+		return;
+	}
+	if (type != GL_DEBUG_TYPE_PERFORMANCE)
+		return;
+
+	c = categorize(message, length);
+	d->frame_perf[c].fetch_add(1, std::memory_order_relaxed);
+	d->total_perf[c].fetch_add(1, std::memory_order_relaxed);
+	if (d->log)
+		fprintf(stderr, "GL [frame %llu] performance (%s): %.*s\n",
+		        d->frame, category_names[c], (int)length, message);
+}
+
+void gl_debug_init(struct gl_debug *d, bool log)
+{
+	d->enabled = false;
+	d->log = log;
+	d->frame = 0;
+	for (int i = 0; i < GL_PERF_NUM_CATEGORIES; i++) {
+		d->frame_perf[i] = 0;
+		d->total_perf[i] = 0;
+	}
+	d->total_errors = 0;
+
+	if (!GLEW_KHR_debug && !GLEW_VERSION_4_3) {
+		if (log)
+			fprintf(stderr, "KHR_debug not supported, no GL debug output\n");
+		return;
+	}
+
+	glEnable(GL_DEBUG_OUTPUT);
+	if (log)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDebugMessageCallback(debug_callback, d);
+
+	// Only ask for what is counted, so chatty drivers cost less
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_FALSE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR, GL_DONT_CARE, 0, NULL, GL_TRUE);
+	d->enabled = true;
+}
+
+void gl_debug_new_frame(struct gl_debug *d, unsigned long long frame)
+{
+	d->frame = frame;
+	for (int i = 0; i < GL_PERF_NUM_CATEGORIES; i++)
+		d->frame_perf[i].store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,40 @@
+#ifndef GLDEBUG_H
+#define GLDEBUG_H
+
+#include <GL/glew.h>
+#include <atomic>
+
+// What GL_DEBUG_TYPE_PERFORMANCE messages are about, guessed from their text
+enum gl_perf_category {
+	GL_PERF_IMPLICIT_SYNC,
+	GL_PERF_RECOMPILE,
+	GL_PERF_BUFFER_MIGRATION,
+	GL_PERF_OTHER,
+	GL_PERF_NUM_CATEGORIES,
+};
+
+struct gl_debug {
+	bool enabled;
+	bool log;
+	unsigned long long frame; // Only read by the callback when logging
+
+	// Performance messages of the current frame and of all frames. Without
+	// log the driver may count them from a thread of its own, a little late
+	std::atomic<unsigned> frame_perf[GL_PERF_NUM_CATEGORIES];
+	std::atomic<unsigned long long> total_perf[GL_PERF_NUM_CATEGORIES];
+	std::atomic<unsigned long long> total_errors;
+};
+
+const char *gl_perf_category_name(enum gl_perf_category c);
+
+// Hooks glDebugMessageCallback if KHR_debug is there. With log, every
+// performance message and error is printed to stderr, and messages are
+// delivered synchronously so they can be pinned to the frame that caused
+// them. Only counting them does not need that, so it leaves the driver free
+// to deliver them whenever
+void gl_debug_init(struct gl_debug *d, bool log);
+
+// Clears the per frame counts
+void gl_debug_new_frame(struct gl_debug *d, unsigned long long frame);
+
+#endif
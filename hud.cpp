@@ -0,0 +1,251 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "hud.h"
+
+#define GLYPH_W 6 // 5 pixels wide plus spacing
+#define GLYPH_H 8 // 7 pixels tall plus spacing
+
+#define FIRST_GLYPH ' '
+#define NUM_GLYPHS  64
+
+#define HUD_MARGIN_PX 8
+
+// 5x7 pixel font for ' ' to '_', one byte per row with the leftmost pixel in
+// bit 4. Lowercase letters are drawn using their uppercase glyphs
+static const unsigned char font[NUM_GLYPHS][7] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // !
+	{ 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00 }, // "
+	{ 0x0a, 0x1f, 0x0a, 0x0a, 0x0a, 0x1f, 0x0a }, // #
+	{ 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 }, // $
+	{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // %
+	{ 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d }, // &
+	{ 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '
+	{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // (
+	{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // )
+	{ 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 }, // *
+	{ 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 }, // +
+	{ 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 }, // ,
+	{ 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 }, // -
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c }, // .
+	{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+	{ 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e }, // 0
+	{ 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e }, // 1
+	{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f }, // 2
+	{ 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e }, // 3
+	{ 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 }, // 4
+	{ 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e }, // 5
+	{ 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e }, // 6
+	{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // 7
+	{ 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e }, // 8
+	{ 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c }, // 9
+	{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 }, // :
+	{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 }, // ;
+	{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // <
+	{ 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 }, // =
+	{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // >
+	{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // ?
+	{ 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e }, // @
+	{ 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // A
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e }, // B
+	{ 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e }, // C
+	{ 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c }, // D
+	{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f }, // E
+	{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 }, // F
+	{ 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f }, // G
+	{ 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // H
+	{ 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // I
+	{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c }, // J
+	{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // K
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f }, // L
+	{ 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 }, // M
+	{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // N
+	{ 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // O
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 }, // P
+	{ 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d }, // Q
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 }, // R
+	{ 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e }, // S
+	{ 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // T
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // U
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // V
+	{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a }, // W
+	{ 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 }, // X
+	{ 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04 }, // Y
+	{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f }, // Z
+	{ 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e }, // [
+	{ 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // backslash
+	{ 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e }, // ]
+	{ 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 }, // ^
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f }, // _
+};
+
+static GLuint glyph_index(char c)
+{
+	unsigned char u = toupper((unsigned char)c);
+	if (u < FIRST_GLYPH || u >= FIRST_GLYPH + NUM_GLYPHS)
+		u = '?';
+	return u - FIRST_GLYPH;
+}
+
+static void bake_atlas(GLuint *tex)
+{
+	const GLsizei w = NUM_GLYPHS * GLYPH_W;
+	std::vector<unsigned char> pixels(w * GLYPH_H, 0);
+
+	for (int g = 0; g < NUM_GLYPHS; g++) {
+		for (int y = 0; y < 7; y++) {
+			for (int x = 0; x < 5; x++) {
+				if (font[g][y] & (0x10 >> x))
+					pixels[y * w + g * GLYPH_W + x] = 0xff;
+			}
+		}
+	}
+
+	glGenTextures(1, tex);
+	glBindTexture(GL_TEXTURE_2D, *tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, w, GLYPH_H);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, GLYPH_H, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void hud_set_program(struct hud *hud, GLuint prg)
+{
+	glDeleteProgram(hud->prg);
+	hud->prg = prg;
+	hud->cell_size_loc = glGetUniformLocation(prg, "cell_size");
+	hud->origin_loc    = glGetUniformLocation(prg, "origin");
+
+	// The new program has none of the old one's uniforms set
+	hud->fb_width  = 0;
+	hud->fb_height = 0;
+}
+
+void hud_init(struct hud *hud, GLuint prg)
+{
+	hud->prg = 0;
+	hud_set_program(hud, prg);
+	hud->since_update_us = HUD_UPDATE_INTERVAL_US;
+	hud->num_chars = 0;
+
+	bake_atlas(&(hud->atlas));
+
+	glGenVertexArrays(1, &(hud->vao));
+	glBindVertexArray(hud->vao);
+	glGenBuffers(1, &(hud->instance_buf));
+	glBindBuffer(GL_ARRAY_BUFFER, hud->instance_buf);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(hud->instances), NULL, GL_DYNAMIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 0, NULL);
+	glVertexAttribDivisor(0, 1);
+	glBindVertexArray(0);
+}
+
+void hud_destroy(struct hud *hud)
+{
+	glDeleteBuffers(1, &(hud->instance_buf));
+	glDeleteVertexArrays(1, &(hud->vao));
+	glDeleteTextures(1, &(hud->atlas));
+	glDeleteProgram(hud->prg);
+}
+
+static void layout_text(struct hud *hud)
+{
+	GLuint col = 0, row = 0;
+
+	hud->num_chars = 0;
+	for (const char *c = hud->text; *c != '\0'; c++) {
+		if (*c == '\n') {
+			col = 0;
+			row++;
+			continue;
+		}
+		hud->instances[hud->num_chars++] = col | row << 8 | glyph_index(*c) << 16;
+		col++;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, hud->instance_buf);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, hud->num_chars * sizeof(GLuint), hud->instances);
+}
+
+static float ms(float us)
+{
+	return us * 1e-3f;
+}
+
+void hud_update(struct hud *hud, const struct hud_info *info, float frame_us)
+{
+	const struct frame_stats *s = info->stats;
+	float cpu_us = 0.0f;
+
+	hud->since_update_us += frame_us;
+	if (hud->since_update_us < HUD_UPDATE_INTERVAL_US)
+		return;
+	hud->since_update_us = 0.0f;
+
+	// Everything but waiting for the GPU or the swap is actual CPU work
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		if (i != STAGE_WAIT && i != STAGE_SWAP)
+			cpu_us += s->stage_us[i];
+	}
+
+	snprintf(hud->text, sizeof(hud->text),
+	         "FPS %6.1f\n"
+	         "FRAME %6.2f MS  CPU %6.2f MS  GPU %6.2f MS\n"
+	         "WAIT %5.2f  SIM %5.2f  UPLOAD %5.2f  INPUT %5.2f  DRAW %5.2f  SWAP %5.2f\n"
+	         "BALLS %u  TCV %.2f  FRICTION %.3f  GL PERF MSGS %u  %s%s  SCALE %.2f\n"
+	         "KEY LATENCY %.1f MS (%.1f FRAMES)  HUD GPU %5.3f MS",
+	         s->frame_us > 0.0f ? 1e6f / s->frame_us : 0.0f,
+	         ms(s->frame_us), ms(cpu_us), ms(s->gpu_us),
+	         ms(s->stage_us[STAGE_WAIT]),
+	         ms(s->stage_us[STAGE_SIMULATE]), ms(s->stage_us[STAGE_UPLOAD]),
+	         ms(s->stage_us[STAGE_INPUT]), ms(s->stage_us[STAGE_DRAW]),
+	         ms(s->stage_us[STAGE_SWAP]),
+	         info->num_balls, info->tail_critical_value, info->friction,
+	         info->gl_perf_messages, info->compute ? "COMPUTE" : "FRAGMENT",
+	         info->edge_aa ? " EDGE AA" : "",
+	         info->render_scale,
+	         info->key_latency_ms, info->key_latency_frames,
+	         ms(s->hud_gpu_us));
+
+	if (info->debug_mode != 0) {
+		const struct shading_stats *sh = info->shading;
+		size_t len = strlen(hud->text);
+		float contrib_pct = sh->evaluated > 0 ? 100.0f * sh->contributed / sh->evaluated : 0.0f;
+
+		snprintf(hud->text + len, sizeof(hud->text) - len,
+		         "\nFRAGS %.2fM  EVALS %.1fM  CONTRIB %.1fM (%.1f%%)",
+		         sh->invocations * 1e-6f, sh->evaluated * 1e-6f,
+		         sh->contributed * 1e-6f, contrib_pct);
+	}
+	layout_text(hud);
+}
+
+void hud_draw(struct hud *hud, int fb_width, int fb_height)
+{
+	if (hud->num_chars == 0)
+		return;
+
+	glUseProgram(hud->prg);
+	if (fb_width != hud->fb_width || fb_height != hud->fb_height) {
+		float cw = 2.0f * GLYPH_W * HUD_SCALE / fb_width;
+		float ch = 2.0f * GLYPH_H * HUD_SCALE / fb_height;
+		float ox = -1.0f + 2.0f * HUD_MARGIN_PX / fb_width;
+		float oy =  1.0f - 2.0f * HUD_MARGIN_PX / fb_height;
+
+		glProgramUniform2f(hud->prg, hud->cell_size_loc, cw, ch);
+		glProgramUniform2f(hud->prg, hud->origin_loc, ox, oy);
+		hud->fb_width  = fb_width;
+		hud->fb_height = fb_height;
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindVertexArray(hud->vao);
+	glBindTexture(GL_TEXTURE_2D, hud->atlas);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, hud->num_chars);
+	glDisable(GL_BLEND);
+}
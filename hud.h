@@ -0,0 +1,66 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <GL/glew.h>
+
+#include "perf.h"
+
+#define HUD_MAX_CHARS 512
+
+// Glyph pixels are drawn as HUD_SCALE x HUD_SCALE screen pixels
+#define HUD_SCALE 2
+
+// Reformatting the text every frame would make the numbers unreadable anyway
+#define HUD_UPDATE_INTERVAL_US 250000.0f
+
+struct hud_info {
+	const struct frame_stats *stats;
+	GLuint num_balls;
+	float tail_critical_value;
+	float friction;
+	unsigned gl_perf_messages; // In the latest frame
+
+	// From a key press to the GPU finishing the first frame showing it
+	float key_latency_ms;
+	float key_latency_frames;
+
+	bool compute; // Drawn by field_cs.glsl instead of fs.glsl
+	bool edge_aa; // Edges shaded again with more samples
+	float render_scale; // Of the field, per axis
+
+	// Shading statistics are shown while one of the debug heatmaps is on
+	GLuint debug_mode;
+	const struct shading_stats *shading;
+};
+
+struct hud {
+	GLuint prg;
+	GLuint vao;
+	GLuint instance_buf;
+	GLuint atlas;
+
+	GLint cell_size_loc;
+	GLint origin_loc;
+	int fb_width, fb_height;
+
+	float since_update_us;
+	GLuint num_chars;
+	char text[HUD_MAX_CHARS];
+
+	// One per character: column | row << 8 | glyph << 16
+	GLuint instances[HUD_MAX_CHARS];
+};
+
+// Takes ownership of prg, which should be built from hud_vs.glsl and hud_fs.glsl
+void hud_init(struct hud *hud, GLuint prg);
+void hud_destroy(struct hud *hud);
+
+// Swaps in a rebuilt program, taking ownership of it like hud_init
+void hud_set_program(struct hud *hud, GLuint prg);
+
+void hud_update(struct hud *hud, const struct hud_info *info, float frame_us);
+
+// Draws the overlay with one instanced draw on top of whatever is bound
+void hud_draw(struct hud *hud, int fb_width, int fb_height);
+
+#endif
@@ -0,0 +1,19 @@
+#version 460
+
+#define GLYPH_W 6
+
+layout (location = 0) out vec4 fragColor;
+
+uniform sampler2D atlas;
+
+in vec2 glyph_px;
+flat in uint glyph;
+
+void main()
+{
+	ivec2 texel = ivec2(glyph_px) + ivec2(int(glyph) * GLYPH_W, 0);
+	float ink = texelFetch(atlas, texel, 0).r;
+
+	// Unlit glyph pixels double as a backdrop so the text stays readable
+	fragColor = mix(vec4(0.0, 0.0, 0.0, 0.6), vec4(1.0), ink);
+}
@@ -0,0 +1,30 @@
+#version 460
+
+#define GLYPH_W 6
+#define GLYPH_H 8
+
+// column | row << 8 | glyph << 16
+layout (location = 0) in uint glyph_cell;
+
+// Size of one character cell and top left corner of the text, in NDC
+uniform vec2 cell_size;
+uniform vec2 origin;
+
+out vec2 glyph_px;
+flat out uint glyph;
+
+void main()
+{
+	float x = float(((uint(gl_VertexID) + 2u) / 3u)%2u);
+	float y = float(((uint(gl_VertexID) + 1u) / 3u)%2u);
+
+	float col = float(glyph_cell & 0xffu);
+	float row = float((glyph_cell >> 8) & 0xffu);
+	glyph = glyph_cell >> 16;
+
+	// Atlas rows go downwards from the top of the glyph
+	glyph_px = vec2(x * GLYPH_W, (1.0 - y) * GLYPH_H);
+
+	vec2 pos = origin + vec2(col + x, -(row + 1.0 - y)) * cell_size;
+	gl_Position = vec4(pos, 0.0, 1.0);
+}
@@ -0,0 +1,42 @@
+#include <cstdio>
+#include <cstring>
+
+#include "live_params.h"
+
+int live_params_init(struct live_params *lp, GLuint num_slots)
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLint align;
+	GLuint size;
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	lp->stride = (sizeof(struct live_params_block) + align - 1) / align * align;
+	lp->num_slots = num_slots;
+	size = lp->stride * num_slots;
+
+	glGenBuffers(1, &(lp->buf));
+	glBindBuffer(GL_UNIFORM_BUFFER, lp->buf);
+	glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+	lp->mapped = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+	if (lp->mapped == NULL) {
+		fprintf(stderr, "Failed to map live parameter buffer\n");
+		glDeleteBuffers(1, &(lp->buf));
+		return 1;
+	}
+	return 0;
+}
+
+void live_params_destroy(struct live_params *lp)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, lp->buf);
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glDeleteBuffers(1, &(lp->buf));
+}
+
+void live_params_latch(struct live_params *lp, GLuint slot, const struct live_params_block *block)
+{
+	GLuint offset = slot * lp->stride;
+
+	memcpy(lp->mapped + offset, block, sizeof(*block));
+	glBindBufferRange(GL_UNIFORM_BUFFER, LIVE_PARAMS_BINDING, lp->buf, offset, sizeof(*block));
+}
@@ -0,0 +1,36 @@
+#ifndef LIVE_PARAMS_H
+#define LIVE_PARAMS_H
+
+#include <GL/glew.h>
+
+#include "fences.h"
+
+// Uniform block binding of live_params in fs.glsl
+#define LIVE_PARAMS_BINDING 0
+
+// Must match the std140 layout of the live_params block in fs.glsl
+struct live_params_block {
+	GLfloat aspect_ratio;
+	GLfloat tail_critical_value;
+	GLuint  debug_mode;
+	GLuint  pad;
+};
+
+// Parameters the user can change at any time, read by the shader from a
+// persistently mapped buffer. There is one slot per frame in flight, so a
+// slot can be rewritten right before the draw without waiting: the frame
+// fences already guarantee the GPU is done with it
+struct live_params {
+	GLuint buf;
+	GLuint stride;
+	GLuint num_slots;
+	unsigned char *mapped;
+};
+
+int  live_params_init(struct live_params *lp, GLuint num_slots);
+void live_params_destroy(struct live_params *lp);
+
+// Writes the block to slot (as returned by frame_fences_wait) and binds it
+void live_params_latch(struct live_params *lp, GLuint slot, const struct live_params_block *block);
+
+#endif
@@ -1,20 +1,52 @@
 #include <cerrno>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <getopt.h>
+#include <unistd.h>
 #include <algorithm>
 #include <array>
-#include <atomic>
 #include <chrono>
 #include <functional>
 #include <mutex>
 #include <random>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
 
-#define LOG_SZ 1024
+#include "atlas.h"
+#include "bench.h"
+#include "compute.h"
+#include "cpushade.h"
+#include "dynres.h"
+#include "edge_aa.h"
+#include "fences.h"
+#include "frame_export.h"
+#include "git_commit.h"
+#include "gldebug.h"
+#include "hud.h"
+#include "live_params.h"
+#include "metrics.h"
+#include "perf.h"
+#include "progbuild.h"
+#include "progcache.h"
+#include "record.h"
+#include "shaders.h"
+#include "shard.h"
+#include "shaderwatch.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "still.h"
+#include "tilebin.h"
+#include "uniforms.h"
+#include "variants.h"
+#include "wall.h"
 
 #define STEP_PER_US_1HZ 1e-8f
 
@@ -44,89 +76,180 @@
 
 #define INITIAL_FRICTION 0.15f
 
+// Radius culling pays for its branch when an average pixel is within reach
+// of less than this share of the balls
+#define CULL_MAX_COVERAGE 0.5f
+
+// Balls warped less than this count as not warped at all
+#define WARP_EPSILON 1e-4f
+
+// Size of the hidden window that holds the context when recording or
+// rendering stills
+#define OFFLINE_WINDOW_SIZE 64
+
 #define ROT_SPEED_FACTOR   0.10f
 #define WRP_SPEED_FACTOR   0.10f
 #define PLP_SPEED_FACTOR   0.03f
 
+// Values of the debug_mode uniform in fs.glsl
+#define DEBUG_OFF         0
+#define DEBUG_CONTRIBUTED 1
+#define DEBUG_EVALUATED   2
+#define NUM_DEBUG_MODES   3
+
 #define SHARPNESS_STEP 0.05f
 #define FRICTION_STEP 1.3f // Note: friction grows geometrically
 
-struct vec2 {
-	float x, y;
-	vec2() : x(0.0f), y(0.0f) {}
-	vec2(float x_, float y_) : x(x_), y(y_) {}
-};
-
-struct vec3 {
-	float x, y, z;
-	vec3() : x(0.0f), y(0.0f), z(0.0f) {}
-	vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
-};
-
-struct vec4 {
-	float x, y, z, w;
-	vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
-	vec4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
-};
-
-struct rwp_vs {
-	float rot_v, wrp_v, plp_v;
-	rwp_vs() : rot_v(0.0f), wrp_v(0.0f), plp_v(0.0f) {}
-	rwp_vs(float rot_v_, float wrp_v_, float plp_v_)
-		: rot_v(rot_v_)
-		, wrp_v(wrp_v_)
-		, plp_v(plp_v_)
-	{}
-};
-
 struct user_params {
 	float tail_critical_value;
 	float friction;
 	bool do_draw;
 	bool limit_time;
+	bool show_hud;
+	GLuint debug_mode;
+	bool compute;
+	bool edge_aa;
 
 	user_params()
 		: tail_critical_value(INITIAL_TAIL_CRITICAL_CALUE)
 		, friction(INITIAL_FRICTION)
 		, do_draw(true)
 		, limit_time(true)
+		, show_hud(false)
+		, debug_mode(DEBUG_OFF)
+		, compute(false)
+		, edge_aa(false)
 	{}
 
-	user_params(float tcv_, float friction_, bool do_draw_, bool limit_time_)
+	user_params(float tcv_, float friction_, bool do_draw_, bool limit_time_, bool show_hud_,
+	            GLuint debug_mode_, bool compute_, bool edge_aa_)
 		: tail_critical_value(tcv_)
 		, friction(friction_)
 		, do_draw(do_draw_)
 		, limit_time(limit_time_)
+		, show_hud(show_hud_)
+		, debug_mode(debug_mode_)
+		, compute(compute_)
+		, edge_aa(edge_aa_)
 	{}
 };
 
-// Hacky.. the flag indicates whether aspect ratio change has been handled
+// Read shaders from here instead of using the copies built into the binary
+static const char *shader_dir;
+
 static float aspect_ratio;
-std::atomic_flag aspect_ratio_clean = ATOMIC_FLAG_INIT;
+static int fb_width, fb_height;
+
+// Of the scene when it is not the window's: on a wall, where every window
+// shows a part of the same canvas, and for the cells of a thumbnail atlas
+static float canvas_aspect_ratio;
 
-struct {
-	GLuint num_balls_loc;
-	GLuint aspect_ratio_loc;
-	GLuint tail_critical_value_loc;
-	GLuint ball_pos_rad_loc;
-	GLuint ball_color_loc;
-	GLuint ball_params_loc;
-} uniform_locs;
+// Bumped whenever the simulation changes the corresponding ball array
+struct ball_versions {
+	GLuint pos_rad;
+	GLuint color;
+	GLuint params;
+};
+
+struct options {
+	bool seed_given;
+	GLuint seed;
+
+	GLuint bench_frames;
+	GLuint bench_warmup;
+	const char *bench_results;
+
+	const char *compare_base;
+	const char *compare_head;
+	float compare_threshold;
+
+	const char *metrics_socket;
+	const char *export_socket;
+	bool gl_debug;
+	GLuint frames_in_flight;
+	bool program_cache;
+	const char *shader_dir;
+	bool compute;
+	bool dynamic_resolution;
+	bool edge_aa;
+	bool half;
+
+	// Seeds to compare half precision colors on, see cpushade.h
+	unsigned half_report;
+
+	// Recording is on if frames > 0, a size of 0 means the monitor's
+	struct record_config record;
+
+	// A still is rendered if path is set, a size of 0 means the monitor's
+	struct still_config still;
+
+	// Thumbnails are rendered if path is set, the first seed is seed
+	struct atlas_config thumbnails;
+
+	// Sharded recording, see shard.h
+	const char *coordinate_dir;
+	const char *worker_dir;
+	unsigned workers;
+	unsigned shard_frames;
+
+	// A render wall is joined if wall is set, see wall.h. Sizes of 0 mean
+	// the monitor's and the whole canvas
+	const char *wall;
+	bool wall_authority;
+	int wall_canvas_width, wall_canvas_height;
+	int wall_rect[4];
+	int wall_monitor;
+
+	options()
+		: seed_given(false)
+		, seed(0)
+		, bench_frames(0)
+		, bench_warmup(BENCH_DEFAULT_WARMUP)
+		, bench_results(BENCH_DEFAULT_RESULTS)
+		, compare_base(NULL)
+		, compare_head(NULL)
+		, compare_threshold(BENCH_DEFAULT_THRESHOLD)
+		, metrics_socket(NULL)
+		, export_socket(NULL)
+		, gl_debug(false)
+		, frames_in_flight(DEFAULT_FRAMES_IN_FLIGHT)
+		, program_cache(true)
+		, shader_dir(NULL)
+		, compute(false)
+		, dynamic_resolution(false)
+		, edge_aa(false)
+		, half(false)
+		, half_report(0)
+		, record({ 0, 0, 0, RECORD_DEFAULT_FPS, RECORD_Y4M, "-" })
+		, still({ 0, 0, 1, NULL })
+		, thumbnails({ ATLAS_DEFAULT_COUNT, ATLAS_DEFAULT_CELL_WIDTH, ATLAS_DEFAULT_CELL_HEIGHT, 1, NULL })
+		, coordinate_dir(NULL)
+		, worker_dir(NULL)
+		, workers(std::thread::hardware_concurrency())
+		, shard_frames(SHARD_DEFAULT_FRAMES)
+		, wall(NULL)
+		, wall_authority(false)
+		, wall_canvas_width(0)
+		, wall_canvas_height(0)
+		, wall_rect{ 0, 0, 0, 0 }
+		, wall_monitor(0)
+	{}
+};
 
 typedef std::function<void(struct user_params *)> key_callback;
 
-typedef std::pair<const char *, GLuint *> uniform_name_loc_mapping;
+typedef std::pair<const char *, GLint ball_uniforms::*> uniform_name_loc_mapping;
 typedef std::tuple<int, GLuint, key_callback> key_to_count_mapping;
 
 // God I wish there was std::make_array that would infer its size from
 // initializer list size
 const std::array<uniform_name_loc_mapping, 6> un2l = {
-	std::make_pair("num_balls", &(uniform_locs.num_balls_loc)),
-	std::make_pair("aspect_ratio", &(uniform_locs.aspect_ratio_loc)),
-	std::make_pair("tail_critical_value", &(uniform_locs.tail_critical_value_loc)),
-	std::make_pair("ball_pos_rad", &(uniform_locs.ball_pos_rad_loc)),
-	std::make_pair("ball_color", &(uniform_locs.ball_color_loc)),
-	std::make_pair("ball_params", &(uniform_locs.ball_params_loc)),
+	std::make_pair("num_balls", &ball_uniforms::num_balls_loc),
+	std::make_pair("ball_pos_rad", &ball_uniforms::ball_pos_rad_loc),
+	std::make_pair("ball_color", &ball_uniforms::ball_color_loc),
+	std::make_pair("ball_params", &ball_uniforms::ball_params_loc),
+	std::make_pair("view_rect", &ball_uniforms::view_rect_loc),
+	std::make_pair("aa_pass", &ball_uniforms::aa_pass_loc),
 };
 
 static void sharpen_balls_callback    (struct user_params *);
@@ -135,18 +258,40 @@ static void toggle_draw_callback      (struct user_params *);
 static void toggle_limit_time_callback(struct user_params *);
 static void more_friction_callback    (struct user_params *);
 static void less_friction_callback    (struct user_params *);
+static void toggle_hud_callback       (struct user_params *);
+static void cycle_debug_mode_callback (struct user_params *);
+static void toggle_compute_callback   (struct user_params *);
+static void toggle_edge_aa_callback   (struct user_params *);
 
-std::array<key_to_count_mapping, 6> interesting_keys = {
+std::array<key_to_count_mapping, 10> interesting_keys = {
 	std::make_tuple(GLFW_KEY_UP,   0, sharpen_balls_callback),
 	std::make_tuple(GLFW_KEY_DOWN, 0, unsharpen_balls_callback),
 	std::make_tuple(GLFW_KEY_D,    0, toggle_draw_callback),
 	std::make_tuple(GLFW_KEY_L,    0, toggle_limit_time_callback),
 	std::make_tuple(GLFW_KEY_F,    0, more_friction_callback),
 	std::make_tuple(GLFW_KEY_V,    0, less_friction_callback),
+	std::make_tuple(GLFW_KEY_H,    0, toggle_hud_callback),
+	std::make_tuple(GLFW_KEY_M,    0, cycle_debug_mode_callback),
+	std::make_tuple(GLFW_KEY_C,    0, toggle_compute_callback),
+	std::make_tuple(GLFW_KEY_A,    0, toggle_edge_aa_callback),
 };
 
 std::mutex key_mtx;
 
+// When the oldest key press not yet handled by process_input arrived
+static bool key_press_pending;
+static std::chrono::steady_clock::time_point key_press_time;
+
+// From a key press to the GPU finishing the first frame that shows it. The
+// display may take up to another refresh on top of that
+struct key_latency {
+	bool pending;
+	std::chrono::steady_clock::time_point press;
+	GLuint64 frame; // First frame with the change
+	float ms;
+	float frames;
+};
+
 static void sharpen_balls_callback(struct user_params *params)
 {
 	float *tcv = &(params->tail_critical_value);
@@ -179,14 +324,389 @@ static void less_friction_callback(struct user_params *params)
 	params->friction *= (1.0f / FRICTION_STEP);
 }
 
-static void get_uniform_locs(GLuint prg)
+static void toggle_hud_callback(struct user_params *params)
+{
+	params->show_hud = !(params->show_hud);
+}
+
+static void cycle_debug_mode_callback(struct user_params *params)
+{
+	params->debug_mode = (params->debug_mode + 1) % NUM_DEBUG_MODES;
+}
+
+static void toggle_compute_callback(struct user_params *params)
+{
+	params->compute = !(params->compute);
+}
+
+static void toggle_edge_aa_callback(struct user_params *params)
+{
+	params->edge_aa = !(params->edge_aa);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  --seed N                 Seed the ball generator with N instead of the clock\n"
+	        "  --bench FRAMES           Time FRAMES frames without vsync, print the result\n"
+	        "                           as JSON and append it to the results file\n"
+	        "  --bench-warmup FRAMES    Frames to skip before timing (default %d)\n"
+	        "  --bench-results FILE     Results file (default %s)\n"
+	        "  --bench-compare BASE HEAD\n"
+	        "                           Compare the runs of two commits in the results file\n"
+	        "  --bench-threshold F      Smallest relative slowdown reported as a regression\n"
+	        "                           (default %.2f)\n"
+	        "  --metrics-socket PATH    Serve Prometheus metrics on a Unix socket at PATH\n"
+	        "  --export-socket PATH     Share the rendered frames with other processes,\n"
+	        "                           which get them from a Unix socket at PATH\n"
+	        "  --gl-debug               Use a debug context and log driver performance\n"
+	        "                           warnings and errors\n"
+	        "  --frames-in-flight N     How many frames the GPU may lag behind, %d to %d\n"
+	        "                           (default %d)\n"
+	        "  --no-program-cache       Always compile shaders instead of loading cached\n"
+	        "                           program binaries\n"
+	        "  --shader-dir DIR         Load shaders from DIR instead of the built in ones\n"
+	        "  --compute                Start with the compute shader renderer\n"
+	        "  --dynamic-resolution     Lower the resolution of the balls when the GPU\n"
+	        "                           falls behind\n"
+	        "  --edge-aa                Start with the edges of the balls antialiased\n"
+	        "  --half                   Mix the colors in half precision where the GPU\n"
+	        "                           has it\n"
+	        "  --half-report SEEDS      Compare half precision colors against full\n"
+	        "                           precision on the CPU for SEEDS seeds, starting\n"
+	        "                           from --seed, and print the error\n"
+	        "  --record FRAMES          Render FRAMES frames offline in a hidden window\n"
+	        "                           and write them out as video\n"
+	        "  --record-size WxH        Resolution to record at (default the monitor's)\n"
+	        "  --record-fps N           Frame rate to record at (default %d)\n"
+	        "  --record-format FORMAT   y4m or rgb24 (default y4m)\n"
+	        "  --record-output FILE     Where to write the video, - for stdout (default -)\n"
+	        "  --still FILE             Render a single frame of any size into a PNG\n"
+	        "  --still-size WxH         Size of the still (default the monitor's)\n"
+	        "  --still-frame N          Frame of the animation to render (default 1)\n"
+	        "  --thumbnails FILE        Render thumbnails of many seeds, starting from\n"
+	        "                           --seed, as a grid in a PNG\n"
+	        "  --thumbnail-count N      How many seeds (default %d)\n"
+	        "  --thumbnail-size WxH     Size of each thumbnail (default %dx%d)\n"
+	        "  --thumbnail-frame N      Frame of the animation to render (default 1)\n"
+	        "  --coordinate DIR         Split a --record job into shards in DIR and render\n"
+	        "                           them with worker processes, or resume the job\n"
+	        "                           already there\n"
+	        "  --workers N              Local workers to run, 0 to only wait for workers\n"
+	        "                           on other machines (default one per CPU)\n"
+	        "  --shard-frames N         Frames per shard (default %d)\n"
+	        "  --worker DIR             Render one shard of the job in DIR\n"
+	        "  --wall NAME              Draw a part of a canvas shared by several\n"
+	        "                           processes, all showing the same frame\n"
+	        "  --wall-authority         Run the simulation of the wall, the others only\n"
+	        "                           draw it. Start this one first\n"
+	        "  --wall-canvas WxH        Size of the whole wall, given to the authority\n"
+	        "                           (default the monitor's)\n"
+	        "  --wall-rect X,Y,W,H      Part of the canvas to draw, in canvas pixels from\n"
+	        "                           the top left (default all of it)\n"
+	        "  --wall-monitor N         Monitor to show the part on, counting from 0\n"
+	        "                           (default the primary)\n",
+	        argv0, BENCH_DEFAULT_WARMUP, BENCH_DEFAULT_RESULTS, BENCH_DEFAULT_THRESHOLD,
+	        MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT, DEFAULT_FRAMES_IN_FLIGHT,
+	        RECORD_DEFAULT_FPS, ATLAS_DEFAULT_COUNT, ATLAS_DEFAULT_CELL_WIDTH,
+	        ATLAS_DEFAULT_CELL_HEIGHT, SHARD_DEFAULT_FRAMES);
+}
+
+enum {
+	OPT_SEED = 0x100,
+	OPT_BENCH,
+	OPT_BENCH_WARMUP,
+	OPT_BENCH_RESULTS,
+	OPT_BENCH_COMPARE,
+	OPT_BENCH_THRESHOLD,
+	OPT_METRICS_SOCKET,
+	OPT_EXPORT_SOCKET,
+	OPT_GL_DEBUG,
+	OPT_FRAMES_IN_FLIGHT,
+	OPT_NO_PROGRAM_CACHE,
+	OPT_SHADER_DIR,
+	OPT_COMPUTE,
+	OPT_DYNAMIC_RESOLUTION,
+	OPT_EDGE_AA,
+	OPT_HALF,
+	OPT_HALF_REPORT,
+	OPT_RECORD,
+	OPT_RECORD_SIZE,
+	OPT_RECORD_FPS,
+	OPT_RECORD_FORMAT,
+	OPT_RECORD_OUTPUT,
+	OPT_STILL,
+	OPT_STILL_SIZE,
+	OPT_STILL_FRAME,
+	OPT_THUMBNAILS,
+	OPT_THUMBNAIL_COUNT,
+	OPT_THUMBNAIL_SIZE,
+	OPT_THUMBNAIL_FRAME,
+	OPT_COORDINATE,
+	OPT_WORKERS,
+	OPT_SHARD_FRAMES,
+	OPT_WORKER,
+	OPT_WALL,
+	OPT_WALL_AUTHORITY,
+	OPT_WALL_CANVAS,
+	OPT_WALL_RECT,
+	OPT_WALL_MONITOR,
+};
+
+static int parse_options(int argc, char **argv, struct options *opts)
+{
+	static const struct option longopts[] = {
+		{ "seed",            required_argument, NULL, OPT_SEED },
+		{ "bench",           required_argument, NULL, OPT_BENCH },
+		{ "bench-warmup",    required_argument, NULL, OPT_BENCH_WARMUP },
+		{ "bench-results",   required_argument, NULL, OPT_BENCH_RESULTS },
+		{ "bench-compare",   required_argument, NULL, OPT_BENCH_COMPARE },
+		{ "bench-threshold", required_argument, NULL, OPT_BENCH_THRESHOLD },
+		{ "metrics-socket",  required_argument, NULL, OPT_METRICS_SOCKET },
+		{ "export-socket",   required_argument, NULL, OPT_EXPORT_SOCKET },
+		{ "gl-debug",        no_argument,       NULL, OPT_GL_DEBUG },
+		{ "frames-in-flight", required_argument, NULL, OPT_FRAMES_IN_FLIGHT },
+		{ "no-program-cache", no_argument,      NULL, OPT_NO_PROGRAM_CACHE },
+		{ "shader-dir",      required_argument, NULL, OPT_SHADER_DIR },
+		{ "compute",         no_argument,       NULL, OPT_COMPUTE },
+		{ "dynamic-resolution", no_argument,    NULL, OPT_DYNAMIC_RESOLUTION },
+		{ "edge-aa",         no_argument,       NULL, OPT_EDGE_AA },
+		{ "half",            no_argument,       NULL, OPT_HALF },
+		{ "half-report",     required_argument, NULL, OPT_HALF_REPORT },
+		{ "record",          required_argument, NULL, OPT_RECORD },
+		{ "record-size",     required_argument, NULL, OPT_RECORD_SIZE },
+		{ "record-fps",      required_argument, NULL, OPT_RECORD_FPS },
+		{ "record-format",   required_argument, NULL, OPT_RECORD_FORMAT },
+		{ "record-output",   required_argument, NULL, OPT_RECORD_OUTPUT },
+		{ "still",           required_argument, NULL, OPT_STILL },
+		{ "still-size",      required_argument, NULL, OPT_STILL_SIZE },
+		{ "still-frame",     required_argument, NULL, OPT_STILL_FRAME },
+		{ "thumbnails",      required_argument, NULL, OPT_THUMBNAILS },
+		{ "thumbnail-count", required_argument, NULL, OPT_THUMBNAIL_COUNT },
+		{ "thumbnail-size",  required_argument, NULL, OPT_THUMBNAIL_SIZE },
+		{ "thumbnail-frame", required_argument, NULL, OPT_THUMBNAIL_FRAME },
+		{ "coordinate",      required_argument, NULL, OPT_COORDINATE },
+		{ "workers",         required_argument, NULL, OPT_WORKERS },
+		{ "shard-frames",    required_argument, NULL, OPT_SHARD_FRAMES },
+		{ "worker",          required_argument, NULL, OPT_WORKER },
+		{ "wall",            required_argument, NULL, OPT_WALL },
+		{ "wall-authority",  no_argument,       NULL, OPT_WALL_AUTHORITY },
+		{ "wall-canvas",     required_argument, NULL, OPT_WALL_CANVAS },
+		{ "wall-rect",       required_argument, NULL, OPT_WALL_RECT },
+		{ "wall-monitor",    required_argument, NULL, OPT_WALL_MONITOR },
+		{ "help",            no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "h", longopts, NULL)) != -1) {
+		switch (c) {
+		case OPT_SEED:
+			opts->seed_given = true;
+			opts->seed = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_BENCH:
+			opts->bench_frames = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_BENCH_WARMUP:
+			opts->bench_warmup = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_BENCH_RESULTS:
+			opts->bench_results = optarg;
+			break;
+		case OPT_BENCH_COMPARE:
+			// Second commit is the following plain argument
+			if (optind >= argc) {
+				usage(argv[0]);
+				return 1;
+			}
+			opts->compare_base = optarg;
+			opts->compare_head = argv[optind++];
+			break;
+		case OPT_BENCH_THRESHOLD:
+			opts->compare_threshold = strtof(optarg, NULL);
+			break;
+		case OPT_METRICS_SOCKET:
+			opts->metrics_socket = optarg;
+			break;
+		case OPT_EXPORT_SOCKET:
+			opts->export_socket = optarg;
+			break;
+		case OPT_GL_DEBUG:
+			opts->gl_debug = true;
+			break;
+		case OPT_FRAMES_IN_FLIGHT:
+			opts->frames_in_flight = strtoul(optarg, NULL, 0);
+			if (opts->frames_in_flight < MIN_FRAMES_IN_FLIGHT ||
+			    opts->frames_in_flight > MAX_FRAMES_IN_FLIGHT) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_NO_PROGRAM_CACHE:
+			opts->program_cache = false;
+			break;
+		case OPT_SHADER_DIR:
+			opts->shader_dir = optarg;
+			break;
+		case OPT_COMPUTE:
+			opts->compute = true;
+			break;
+		case OPT_DYNAMIC_RESOLUTION:
+			opts->dynamic_resolution = true;
+			break;
+		case OPT_EDGE_AA:
+			opts->edge_aa = true;
+			break;
+		case OPT_HALF:
+			opts->half = true;
+			break;
+		case OPT_HALF_REPORT:
+			opts->half_report = strtoul(optarg, NULL, 0);
+			if (opts->half_report == 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_RECORD:
+			opts->record.frames = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_RECORD_SIZE:
+			if (sscanf(optarg, "%dx%d", &(opts->record.width), &(opts->record.height)) != 2 ||
+			    opts->record.width <= 0 || opts->record.height <= 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_RECORD_FPS:
+			opts->record.fps = strtoul(optarg, NULL, 0);
+			if (opts->record.fps == 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_RECORD_FORMAT:
+			if (strcmp(optarg, "y4m") == 0) {
+				opts->record.format = RECORD_Y4M;
+			} else if (strcmp(optarg, "rgb24") == 0) {
+				opts->record.format = RECORD_RGB24;
+			} else {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_RECORD_OUTPUT:
+			opts->record.path = optarg;
+			break;
+		case OPT_STILL:
+			opts->still.path = optarg;
+			break;
+		case OPT_STILL_SIZE:
+			if (sscanf(optarg, "%dx%d", &(opts->still.width), &(opts->still.height)) != 2 ||
+			    opts->still.width <= 0 || opts->still.height <= 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_STILL_FRAME:
+			opts->still.frame = strtoul(optarg, NULL, 0);
+			if (opts->still.frame == 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_THUMBNAILS:
+			opts->thumbnails.path = optarg;
+			break;
+		case OPT_THUMBNAIL_COUNT:
+			opts->thumbnails.count = strtoul(optarg, NULL, 0);
+			if (opts->thumbnails.count == 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_THUMBNAIL_SIZE:
+			if (sscanf(optarg, "%dx%d", &(opts->thumbnails.cell_width),
+			           &(opts->thumbnails.cell_height)) != 2 ||
+			    opts->thumbnails.cell_width <= 0 || opts->thumbnails.cell_height <= 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_THUMBNAIL_FRAME:
+			opts->thumbnails.frame = strtoul(optarg, NULL, 0);
+			if (opts->thumbnails.frame == 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_COORDINATE:
+			opts->coordinate_dir = optarg;
+			break;
+		case OPT_WORKERS:
+			opts->workers = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_SHARD_FRAMES:
+			opts->shard_frames = strtoul(optarg, NULL, 0);
+			if (opts->shard_frames == 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_WORKER:
+			opts->worker_dir = optarg;
+			break;
+		case OPT_WALL:
+			opts->wall = optarg;
+			break;
+		case OPT_WALL_AUTHORITY:
+			opts->wall_authority = true;
+			break;
+		case OPT_WALL_CANVAS:
+			if (sscanf(optarg, "%dx%d", &(opts->wall_canvas_width), &(opts->wall_canvas_height)) != 2 ||
+			    opts->wall_canvas_width <= 0 || opts->wall_canvas_height <= 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_WALL_RECT:
+			if (sscanf(optarg, "%d,%d,%d,%d", &(opts->wall_rect[0]), &(opts->wall_rect[1]),
+			           &(opts->wall_rect[2]), &(opts->wall_rect[3])) != 4 ||
+			    opts->wall_rect[0] < 0 || opts->wall_rect[1] < 0 ||
+			    opts->wall_rect[2] <= 0 || opts->wall_rect[3] <= 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case OPT_WALL_MONITOR:
+			opts->wall_monitor = strtol(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	// One of benchmarking, recording, stills, thumbnails and walls at a time
+	if (optind < argc || (opts->bench_frames > 0) + (opts->record.frames > 0) +
+	                     (opts->still.path != NULL) + (opts->thumbnails.path != NULL) +
+	                     (opts->wall != NULL) > 1 ||
+	    (opts->wall_authority && opts->wall == NULL)) {
+		usage(argv[0]);
+		return 1;
+	}
+	return 0;
+}
+
+static void get_uniform_locs(struct ball_uniforms *bu, GLuint prg)
 {
 	for (auto it = un2l.begin(); it != un2l.end(); ++it) {
 		const char *uniform_name = it->first;
-		GLuint *loc = it->second;
+		GLint *loc = &(bu->*(it->second));
 
 		*loc = glGetUniformLocation(prg, uniform_name);
 	}
+	uniform_cache_reset(&(bu->cache), prg);
 }
 
 static int read_file(const char *fn, char **dst, GLint *sz)
@@ -206,7 +726,7 @@ static int read_file(const char *fn, char **dst, GLint *sz)
 		rv = 1;
 		goto out_close_f;
 	}
-	if (fread(*dst, 1, *sz, f) != *sz) {
+	if (fread(*dst, 1, *sz, f) != (size_t)*sz) {
 		rv = 1;
 		goto out_dealloc;
 	}
@@ -219,7 +739,9 @@ out:
 	return rv;
 }
 
-static void process_input(GLFWwindow *window, struct user_params *params)
+// Returns true and the arrival time of the oldest press if any keys were handled
+static bool process_input(GLFWwindow *window, struct user_params *params,
+                          std::chrono::steady_clock::time_point *press_time)
 {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
@@ -232,13 +754,41 @@ static void process_input(GLFWwindow *window, struct user_params *params)
 		for (; count > 0; count--)
 			callback(params);
 	}
+	if (!key_press_pending)
+		return false;
+
+	*press_time = key_press_time;
+	key_press_pending = false;
+	return true;
 }
 
-static void resize_callback(GLFWwindow *window, int w, int h)
+static void resize_callback(GLFWwindow * /* window */, int w, int h)
 {
 	glViewport(0, 0, w, h);
-	aspect_ratio = (float)w / (float)h;
-	aspect_ratio_clean.clear();
+	fb_width  = w;
+	fb_height = h;
+	aspect_ratio = canvas_aspect_ratio != 0.0f ? canvas_aspect_ratio : (float)w / (float)h;
+}
+
+// Any of the extensions fs.glsl takes float16_t from for its HALF variant
+static bool have_half_floats(void)
+{
+	static const char *const half_extensions[] = {
+		"GL_AMD_gpu_shader_half_float",
+		"GL_NV_gpu_shader5",
+		"GL_EXT_shader_explicit_arithmetic_types_float16",
+	};
+	GLint n = 0;
+
+	glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+	for (GLint i = 0; i < n; i++) {
+		const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		for (const char *half : half_extensions) {
+			if (strcmp(ext, half) == 0)
+				return true;
+		}
+	}
+	return false;
 }
 
 static void draw(void)
@@ -247,35 +797,64 @@ static void draw(void)
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
-static void update_num_balls(GLuint prg, GLuint num_balls)
+// prg is a fs.glsl program with its uniforms set for the frame
+static int render_still(const struct still_config *config, GLuint prg, GLuint vao)
+{
+	int rv;
+	GLint view_rect_loc = glGetUniformLocation(prg, "view_rect");
+
+	glUseProgram(prg);
+	glBindVertexArray(vao);
+	rv = still_render(config, [&](float x, float y, float w, float h) {
+		glProgramUniform4f(prg, view_rect_loc, x, y, w, h);
+		draw();
+	});
+	glProgramUniform4f(prg, view_rect_loc, 0.0f, 0.0f, 1.0f, 1.0f);
+	if (rv == 0)
+		fprintf(stderr, "Wrote %dx%d still to %s\n", config->width, config->height, config->path);
+	return rv;
+}
+
+static void update_num_balls(struct ball_uniforms *bu, GLuint num_balls)
 {
-	glProgramUniform1ui(prg, uniform_locs.num_balls_loc, num_balls);
+	uniform_cache_1ui(&(bu->cache), bu->num_balls_loc, num_balls);
 }
 
-static void update_ball_pos_rad(GLuint prg, GLuint num_balls, const struct vec3 *ball_pos_rad)
+static void update_ball_pos_rad(struct ball_uniforms *bu, GLuint num_balls,
+                                const struct vec3 *ball_pos_rad, GLuint version)
 {
-	glProgramUniform3fv(prg, uniform_locs.ball_pos_rad_loc, num_balls, (const GLfloat *)ball_pos_rad);
+	uniform_cache_3fv(&(bu->cache), bu->ball_pos_rad_loc, num_balls,
+	                  (const GLfloat *)ball_pos_rad, version);
 }
 
-static void update_ball_color(GLuint prg, GLuint num_balls, const struct vec3 *ball_color)
+static void update_ball_color(struct ball_uniforms *bu, GLuint num_balls,
+                              const struct vec3 *ball_color, GLuint version)
 {
-	glProgramUniform3fv(prg, uniform_locs.ball_color_loc, num_balls, (const GLfloat *)ball_color);
+	uniform_cache_3fv(&(bu->cache), bu->ball_color_loc, num_balls,
+	                  (const GLfloat *)ball_color, version);
 }
 
-static void update_ball_params(GLuint prg, GLuint num_balls, const struct vec4 *ball_params)
+static void update_ball_params(struct ball_uniforms *bu, GLuint num_balls,
+                               const struct vec4 *ball_params, GLuint version)
 {
-	glProgramUniform4fv(prg, uniform_locs.ball_params_loc, num_balls, (const GLfloat *)ball_params);
+	uniform_cache_4fv(&(bu->cache), bu->ball_params_loc, num_balls,
+	                  (const GLfloat *)ball_params, version);
 }
 
-static void update_aspect_ratio_maybe(GLuint prg)
+// The rect never changes, but every newly picked program needs it once
+static void update_view_rect(struct ball_uniforms *bu, const float *view_rect)
 {
-	if (aspect_ratio_clean.test_and_set())
-		glProgramUniform1f(prg, uniform_locs.aspect_ratio_loc, aspect_ratio);
+	uniform_cache_4fv(&(bu->cache), bu->view_rect_loc, 1, view_rect, 1);
 }
 
-static void update_tail_cv(GLuint prg, const struct user_params *params)
+static void latch_live_params(struct live_params *lp, GLuint slot, const struct user_params *params)
 {
-	glProgramUniform1f(prg, uniform_locs.tail_critical_value_loc, params->tail_critical_value);
+	struct live_params_block block = {};
+
+	block.aspect_ratio        = aspect_ratio;
+	block.tail_critical_value = params->tail_critical_value;
+	block.debug_mode          = params->debug_mode;
+	live_params_latch(lp, slot, &block);
 }
 
 static void gen_vao(GLuint *vao)
@@ -284,82 +863,295 @@ static void gen_vao(GLuint *vao)
 	glBindVertexArray(*vao);
 }
 
-static GLuint shader_from_src(const char *fn, GLenum type)
+// Only sources read from shader_dir are malloc'd and need to be freed
+static int load_shader_source(const char *name, const char **src, GLint *sz)
 {
-	GLuint shader = 0;
-	char *src;
-	GLint sz;
-	GLint success;
-	GLchar log[LOG_SZ];
+	std::string path;
+	char *data;
+
+	if (shader_dir == NULL) {
+		for (size_t i = 0; i < sizeof(embedded_shaders) / sizeof(embedded_shaders[0]); i++) {
+			if (strcmp(embedded_shaders[i].name, name) == 0) {
+				*src = embedded_shaders[i].src;
+				*sz  = embedded_shaders[i].len;
+				return 0;
+			}
+		}
+		fprintf(stderr, "No built in shader %s\n", name);
+		return 1;
+	}
 
-	if (read_file(fn, &src, &sz) != 0)
+	path = std::string(shader_dir) + "/" + name;
+	if (read_file(path.c_str(), &data, sz) != 0) {
+		fprintf(stderr, "Failed to read shader %s\n", path.c_str());
+		return 1;
+	}
+	*src = data;
+	return 0;
+}
+
+static void free_shader_source(const char *src)
+{
+	if (shader_dir != NULL)
+		free((void *)src);
+}
+
+// Builds and returns the program right away, see start_program_build for
+// the ones that are allowed to take a while
+static GLuint create_shader_program(const char *vs_fn, const char *fs_fn)
+{
+	GLuint prg = 0;
+	const char *srcs[2];
+	GLint szs[2];
+	uint64_t key;
+
+	if (load_shader_source(vs_fn, &srcs[0], &szs[0]) != 0)
 		goto out;
+	if (load_shader_source(fs_fn, &srcs[1], &szs[1]) != 0)
+		goto out_free_vs;
+
+	key = progcache_key(srcs, szs, 2);
+	prg = progcache_load(key);
+	if (prg != 0)
+		goto out_free_fs;
+
+	prg = progbuild_link(vs_fn, srcs[0], szs[0], fs_fn, srcs[1], szs[1]);
+	if (prg != 0)
+		progcache_store(key, prg);
+
+out_free_fs:
+	free_shader_source(srcs[1]);
+out_free_vs:
+	free_shader_source(srcs[0]);
+out:
+	return prg;
+}
+
+static int start_program_build(struct progbuild *b, const char *vs_fn, const char *fs_fn)
+{
+	int rv = 0;
+	const char *srcs[2];
+	GLint szs[2];
+
+	if (load_shader_source(vs_fn, &srcs[0], &szs[0]) != 0) {
+		rv = 1;
+		goto out;
+	}
+	if (load_shader_source(fs_fn, &srcs[1], &szs[1]) != 0) {
+		rv = 1;
+		goto out_free_vs;
+	}
 
-	shader = glCreateShader(type);
-	glShaderSource(shader, 1, &src, &sz);
-	glCompileShader(shader);
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(shader, LOG_SZ - 1, NULL, log);
-		fprintf(stderr, "Failed to compile shader %s:\n%s\n", fn, log);
-		goto out_delete_shader;
-	}
-	goto out_free;
-
-out_delete_shader:
-	glDeleteShader(shader);
-	shader = 0;
-out_free:
-	free(src);
+	progbuild_start(b, vs_fn, srcs[0], szs[0], fs_fn, srcs[1], szs[1]);
+
+	free_shader_source(srcs[1]);
+out_free_vs:
+	free_shader_source(srcs[0]);
 out:
-	return shader;
+	return rv;
 }
 
-static GLuint create_shader_program(const char *vs_fn, const char *fs_fn)
+static int start_compute_build(struct progbuild *b, const char *cs_fn)
+{
+	const char *src;
+	GLint sz;
+
+	if (load_shader_source(cs_fn, &src, &sz) != 0)
+		return 1;
+
+	progbuild_start_compute(b, cs_fn, src, sz);
+	free_shader_source(src);
+	return 0;
+}
+
+// Hands vs.glsl and fs.glsl to the variant cache, at startup and again
+// whenever they change in shader_dir
+static int load_variant_sources(struct variant_cache *vc, bool reload)
 {
-	GLuint prg = 0, vs, fs;
-	GLint success;
-	GLchar log[LOG_SZ];
+	int rv = 0;
+	const char *srcs[2];
+	GLint szs[2];
 
-	vs = shader_from_src(vs_fn, GL_VERTEX_SHADER);
-	if (vs == 0)
+	if (load_shader_source("vs.glsl", &srcs[0], &szs[0]) != 0) {
+		rv = 1;
 		goto out;
+	}
+	if (load_shader_source("fs.glsl", &srcs[1], &szs[1]) != 0) {
+		rv = 1;
+		goto out_free_vs;
+	}
 
-	fs = shader_from_src(fs_fn, GL_FRAGMENT_SHADER);
-	if (fs == 0)
-		goto out_delete_vs;
-
-	prg = glCreateProgram();
-	if (prg == 0)
-		goto out_delete_fs_vs;
-
-	glAttachShader(prg, vs);
-	glAttachShader(prg, fs);
-	glLinkProgram(prg);
-
-	glGetProgramiv(prg, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(prg, LOG_SZ - 1, NULL, log);
-		fprintf(stderr, "Failed to link shaders %s and %s:\n%s\n", vs_fn, fs_fn, log);
-		goto out_delete_prg;
-	}
-	goto out_delete_fs_vs;
-
-out_delete_prg:
-	glDeleteProgram(prg);
-	prg = 0;
-out_delete_fs_vs:
-	glDeleteShader(fs);
-out_delete_vs:
-	glDeleteShader(vs);
+	if (reload)
+		variant_cache_set_sources(vc, srcs[0], szs[0], srcs[1], szs[1]);
+	else
+		variant_cache_init(vc, "vs.glsl", srcs[0], szs[0], "fs.glsl", srcs[1], szs[1]);
+
+	free_shader_source(srcs[1]);
+out_free_vs:
+	free_shader_source(srcs[0]);
 out:
-	return prg;
+	return rv;
+}
+
+// The variant that can draw any scene
+static void generic_variant_key(struct variant_key *key)
+{
+	key->num_balls    = 0;
+	key->star_corners = 0;
+	key->warp         = true;
+	key->cull         = CULL_NONE;
+	key->atlas        = false;
+	key->edge_aa      = false;
+	key->half         = false;
+}
+
+// The most specialized variant that still draws the scene exactly like the
+// generic one does, apart from what edge_aa and half ask for
+static void select_variant_key(struct variant_key *key, const std::vector<struct vec3> &ball_pos_rad,
+                               const std::vector<struct vec4> &ball_params, float tcv, bool edge_aa,
+                               bool half)
+{
+	GLuint num_balls = ball_pos_rad.size();
+	float reach = 0.0f;
+
+	key->num_balls    = num_balls;
+	key->star_corners = num_balls > 0 ? (GLuint)ball_params[0].x : 0;
+	key->warp         = false;
+	key->atlas        = false;
+	key->edge_aa      = edge_aa;
+	key->half         = half;
+	for (GLuint i = 0; i < num_balls; i++) {
+		float r = ball_pos_rad[i].z;
+
+		if ((GLuint)ball_params[i].x != key->star_corners)
+			key->star_corners = 0;
+		if (std::abs(ball_params[i].w) > WARP_EPSILON)
+			key->warp = true;
+
+		// Area in which the ball can get past kill_tail, see CULL_RADIUS
+		// in fs.glsl
+		reach += (float)M_PI * r * r / tcv;
+	}
+
+	// The screen is aspect_ratio wide and 1 high
+	reach /= aspect_ratio;
+	key->cull = reach < CULL_MAX_COVERAGE * num_balls ? CULL_RADIUS : CULL_NONE;
+}
+
+// Returns the program to draw the balls with this frame and its uniforms: the
+// variant for key if it is built, else the generic variant, else the
+// fallback. Returns 0 if the generic variant failed to build
+static GLuint pick_program(struct variant_cache *vc, const struct variant_key *key,
+                           GLuint fallback_prg, struct ball_uniforms *fallback_uniforms,
+                           GLuint num_balls, struct ball_uniforms **uniforms)
+{
+	struct variant_key generic_key;
+	struct variant *v = variant_cache_get(vc, key);
+
+	if (v->prg == 0) {
+		generic_variant_key(&generic_key);
+		v = variant_cache_get(vc, &generic_key);
+	}
+	if (v->prg == 0) {
+		*uniforms = fallback_uniforms;
+		return v->failed ? 0 : fallback_prg;
+	}
+
+	if (v->fresh) {
+		get_uniform_locs(&(v->uniforms), v->prg);
+		update_num_balls(&(v->uniforms), num_balls);
+		v->fresh = false;
+	}
+	*uniforms = &(v->uniforms);
+	return v->prg;
+}
+
+// Rebuild of a program whose sources changed in shader_dir. The old program
+// keeps running until the new one is ready, and for good if it fails to build.
+// Also works for the first build, when there is no old program yet
+struct program_reload {
+	const char *vs_fn, *fs_fn;
+	const char *cs_fn; // Used instead of the other two for compute programs
+	struct progbuild build;
+	bool building;
+	bool again;  // Sources changed again while building
+	bool loaded; // Some build has succeeded before
+};
+
+static void program_reload_init(struct program_reload *r, const char *vs_fn, const char *fs_fn)
+{
+	r->vs_fn = vs_fn;
+	r->fs_fn = fs_fn;
+	r->cs_fn = NULL;
+	r->building = false;
+	r->again = false;
+	r->loaded = false;
+}
+
+static void program_reload_init_compute(struct program_reload *r, const char *cs_fn)
+{
+	program_reload_init(r, NULL, NULL);
+	r->cs_fn = cs_fn;
+}
+
+static void program_reload_start(struct program_reload *r)
+{
+	if (r->building) {
+		r->again = true;
+		return;
+	}
+	r->again = false;
+	if (r->cs_fn != NULL)
+		r->building = start_compute_build(&(r->build), r->cs_fn) == 0;
+	else
+		r->building = start_program_build(&(r->build), r->vs_fn, r->fs_fn) == 0;
 }
 
-static float rnd_f_minmax(std::minstd_rand &gen, float lo, float hi)
+// Returns the rebuilt program once there is one, 0 otherwise
+static GLuint program_reload_poll(struct program_reload *r)
 {
-	std::normal_distribution<float> distr(0.0f, 1.0f);
-	return distr(gen);
+	enum progbuild_state state;
+
+	if (!r->building)
+		return 0;
+
+	state = progbuild_poll(&(r->build));
+	if (state == PROGBUILD_PENDING)
+		return 0;
+
+	r->building = false;
+	if (r->again) {
+		// Already out of date
+		if (state == PROGBUILD_READY)
+			glDeleteProgram(r->build.prg);
+		program_reload_start(r);
+		return 0;
+	}
+	if (state == PROGBUILD_FAILED) {
+		if (r->loaded)
+			fprintf(stderr, "Keeping the old program\n");
+		return 0;
+	}
+	if (r->loaded && r->cs_fn != NULL)
+		fprintf(stderr, "Reloaded %s\n", r->cs_fn);
+	else if (r->loaded)
+		fprintf(stderr, "Reloaded %s and %s\n", r->vs_fn, r->fs_fn);
+	r->loaded = true;
+	return r->build.prg;
+}
+
+// Blocks until the build in progress is done, returns like program_reload_poll
+static GLuint program_reload_wait(struct program_reload *r)
+{
+	GLuint prg;
+
+	while (r->building) {
+		progbuild_wait(&(r->build));
+		prg = program_reload_poll(r);
+		if (prg != 0)
+			return prg;
+	}
+	return 0;
 }
 
 static void random_saturated_color(struct vec3 *color, std::minstd_rand &gen)
@@ -436,8 +1228,8 @@ static struct vec2 biased_random_force(const struct vec3 &curr_pos, std::minstd_
 
 	std::uniform_real_distribution<float> distr(-FORCE_STRENGTH, FORCE_STRENGTH);
 	struct vec2 force = {
-		.x = distr(gen) + xbias * BIAS_STRENGTH,
-		.y = distr(gen) + ybias * BIAS_STRENGTH,
+		distr(gen) + xbias * BIAS_STRENGTH,
+		distr(gen) + ybias * BIAS_STRENGTH,
 	};
 	return force;
 }
@@ -448,27 +1240,25 @@ static void move_balls(std::vector<struct vec3> &ball_pos_rad,
 		       float step,
                        float friction)
 {
-	for (int i = 0; i < ball_pos_rad.size(); i++) {
+	for (size_t i = 0; i < ball_pos_rad.size(); i++) {
 		struct vec3 &pos_rad  = ball_pos_rad.at(i);
 		struct vec2 &velocity = ball_velocity.at(i);
 
 		// Limit velocities
-		float vx_sqrd = velocity.x * velocity.x;
-		float vy_sqrd = velocity.y * velocity.y;
 		float v_sqrd = velocity.x * velocity.x + velocity.y * velocity.y;
 		struct vec2 friction_force = {
-			.x = -velocity.x * v_sqrd * friction,
-			.y = -velocity.y * v_sqrd * friction,
+			-velocity.x * v_sqrd * friction,
+			-velocity.y * v_sqrd * friction,
 		};
 
 		struct vec2 rnd_force = biased_random_force(pos_rad, gen);
 		struct vec2 force = {
-			.x = rnd_force.x + friction_force.x,
-			.y = rnd_force.y + friction_force.y,
+			rnd_force.x + friction_force.x,
+			rnd_force.y + friction_force.y,
 		};
 		struct vec2 delta_pos = {
-			.x = velocity.x * step + 0.5f * force.x * step * step,
-			.y = velocity.y * step + 0.5f * force.y * step * step,
+			velocity.x * step + 0.5f * force.x * step * step,
+			velocity.y * step + 0.5f * force.y * step * step,
 		};
 		pos_rad.x += delta_pos.x;
 		pos_rad.y += delta_pos.y;
@@ -482,7 +1272,7 @@ static void move_ball_hues(std::vector<struct vec3> &ball_color,
                            std::vector<float> &ball_hue_velocity,
                            float step)
 {
-	for (int i = 0; i < ball_color.size(); i++) {
+	for (size_t i = 0; i < ball_color.size(); i++) {
 		const float &hue_v = ball_hue_velocity.at(i);
 		struct vec3 &color = ball_color.at(i);
 		float &hue = color.x;
@@ -509,7 +1299,7 @@ static void rotate_warp_balls(std::vector<struct vec4> &ball_params,
                         const std::vector<struct rwp_vs> &ball_rwp_velocity,
                               float time)
 {
-	for (int i = 0; i < ball_params.size(); i++) {
+	for (size_t i = 0; i < ball_params.size(); i++) {
 		struct vec4 &curr_params = ball_params.at(i);
 		const struct rwp_vs &curr_rwp = ball_rwp_velocity.at(i);
 
@@ -519,7 +1309,151 @@ static void rotate_warp_balls(std::vector<struct vec4> &ball_params,
 	}
 }
 
-static void key_callback_f(GLFWwindow* window, int key, int scancode, int action, int mods)
+static void simulate(struct sim_state *s, float step, float friction)
+{
+	s->time += step;
+	move_balls(s->ball_pos_rad, s->ball_velocity, s->rndgen, step, friction);
+	move_ball_hues(s->ball_color, s->ball_hue_velocity, step);
+	rotate_warp_balls(s->ball_params, s->ball_rwp_velocity, s->time);
+}
+
+// Everything the seed decides, rndgen is seeded with it
+static void random_scene(struct sim_state *s)
+{
+	std::uniform_real_distribution<float> startingtime_distr(1e3f, 2e3f);
+
+	s->time = startingtime_distr(s->rndgen);
+	for (size_t i = 0; i < s->ball_pos_rad.size(); i++) {
+		random_ball_pos_rad(s->ball_pos_rad.data() + i, s->rndgen);
+		random_saturated_color(s->ball_color.data() + i, s->rndgen);
+		random_ball_params(s->ball_params.data() + i, s->rndgen);
+		random_ball_hue_velocity(s->ball_hue_velocity.data() + i, s->rndgen);
+		random_ball_rwp_velocity(s->ball_rwp_velocity.data() + i, s->rndgen);
+	}
+}
+
+// prg is the atlas variant of fs.glsl. Each cell is the scene of its own seed
+// after as many steps as the main loop would have taken by that frame
+static int render_thumbnails(const struct atlas_config *config, GLuint first_seed, GLuint prg,
+                             GLuint vao, float step, float friction, GLuint num_balls)
+{
+	int rv;
+	struct atlas atlas;
+	struct still_config image;
+	float time;
+	std::minstd_rand rndgen;
+	std::vector<struct vec3> ball_pos_rad(num_balls);
+	std::vector<struct vec3> ball_color(num_balls);
+	std::vector<struct vec2> ball_velocity(num_balls);
+	std::vector<struct vec4> ball_params(num_balls);
+	std::vector<float> ball_hue_velocity(num_balls);
+	std::vector<struct rwp_vs> ball_rwp_velocity(num_balls);
+	struct sim_state sim = {
+		time, rndgen, ball_pos_rad, ball_color, ball_velocity,
+		ball_params, ball_hue_velocity, ball_rwp_velocity,
+	};
+	GLint view_rect_loc = glGetUniformLocation(prg, "view_rect");
+
+	atlas_init(&atlas, config->count, num_balls);
+	for (GLuint cell = 0; cell < config->count; cell++) {
+		rndgen.seed(first_seed + cell);
+		random_scene(&sim);
+		for (unsigned f = 0; f < config->frame; f++)
+			simulate(&sim, step, friction);
+		atlas_set_cell(&atlas, cell, (const GLfloat *)ball_pos_rad.data(),
+		               (const GLfloat *)ball_color.data(), (const GLfloat *)ball_params.data());
+	}
+	atlas_upload(&atlas);
+
+	// The whole grid is one frame to still_render, so a big one is still
+	// drawn in tiles
+	image.width = atlas.header.columns * config->cell_width;
+	image.height = atlas.header.rows * config->cell_height;
+	image.frame = config->frame;
+	image.path = config->path;
+	glUseProgram(prg);
+	glBindVertexArray(vao);
+	rv = still_render(&image, [&](float x, float y, float w, float h) {
+		glProgramUniform4f(prg, view_rect_loc, x, y, w, h);
+		draw();
+	});
+	if (rv == 0)
+		fprintf(stderr, "Wrote seeds %u to %u, %u per row, to %s\n", first_seed,
+		        first_seed + config->count - 1, atlas.header.columns, config->path);
+	atlas_destroy(&atlas);
+	return rv;
+}
+
+// Shades the scene of each seed as it starts out both in single and in half
+// precision on the CPU, and prints how far apart the colors are
+static int half_report(GLuint first_seed, unsigned seeds, GLuint num_balls, float tcv)
+{
+	struct cpushade_error total = {};
+	float time;
+	std::minstd_rand rndgen;
+	std::vector<struct vec3> ball_pos_rad(num_balls);
+	std::vector<struct vec3> ball_color(num_balls);
+	std::vector<struct vec2> ball_velocity(num_balls);
+	std::vector<struct vec4> ball_params(num_balls);
+	std::vector<float> ball_hue_velocity(num_balls);
+	std::vector<struct rwp_vs> ball_rwp_velocity(num_balls);
+	struct sim_state sim = {
+		time, rndgen, ball_pos_rad, ball_color, ball_velocity,
+		ball_params, ball_hue_velocity, ball_rwp_velocity,
+	};
+	struct cpushade_scene scene = {
+		num_balls, 0.0f, tcv, (const GLfloat *)ball_pos_rad.data(),
+		(const GLfloat *)ball_color.data(), (const GLfloat *)ball_params.data(),
+	};
+
+	// random_scene places the balls by it
+	aspect_ratio = (float)CPUSHADE_REPORT_WIDTH / (float)CPUSHADE_REPORT_HEIGHT;
+	scene.aspect_ratio = aspect_ratio;
+
+	printf("%-10s %10s %10s %10s\n", "seed", "max", "mean", "changed");
+	for (unsigned i = 0; i < seeds; i++) {
+		struct cpushade_error err = {};
+
+		rndgen.seed(first_seed + i);
+		random_scene(&sim);
+		cpushade_compare(&scene, CPUSHADE_REPORT_WIDTH, CPUSHADE_REPORT_HEIGHT, &err);
+		printf("%-10u %10.3f %10.4f %9.3f%%\n", first_seed + i, err.max,
+		       err.sum / err.channels, 100.0 * err.changed / err.channels);
+
+		total.max = std::max(total.max, err.max);
+		total.sum += err.sum;
+		total.channels += err.channels;
+		total.changed += err.changed;
+	}
+	printf("%-10s %10.3f %10.4f %9.3f%%\n", "all", total.max,
+	       total.sum / total.channels, 100.0 * total.changed / total.channels);
+	return 0;
+}
+
+// Only what is drawn goes on the wall, the renderers do not simulate
+static void publish_wall_state(struct wall_state *ws, const struct sim_state *s,
+                               GLuint num_balls, float tail_critical_value)
+{
+	ws->num_balls = std::min(num_balls, (GLuint)WALL_MAX_BALLS);
+	ws->tail_critical_value = tail_critical_value;
+	memcpy(ws->ball_pos_rad, s->ball_pos_rad.data(), ws->num_balls * sizeof(struct vec3));
+	memcpy(ws->ball_color, s->ball_color.data(), ws->num_balls * sizeof(struct vec3));
+	memcpy(ws->ball_params, s->ball_params.data(), ws->num_balls * sizeof(struct vec4));
+}
+
+static void receive_wall_state(const struct wall_state *ws, struct sim_state *s,
+                               float *tail_critical_value)
+{
+	size_t n = std::min((size_t)ws->num_balls, s->ball_pos_rad.size());
+
+	*tail_critical_value = ws->tail_critical_value;
+	memcpy(s->ball_pos_rad.data(), ws->ball_pos_rad, n * sizeof(struct vec3));
+	memcpy(s->ball_color.data(), ws->ball_color, n * sizeof(struct vec3));
+	memcpy(s->ball_params.data(), ws->ball_params, n * sizeof(struct vec4));
+}
+
+static void key_callback_f(GLFWwindow * /* window */, int key, int /* scancode */, int action,
+                           int /* mods */)
 {
 	std::lock_guard<std::mutex> lck(key_mtx);
 
@@ -527,18 +1461,167 @@ static void key_callback_f(GLFWwindow* window, int key, int scancode, int action
 		int keycode = std::get<0>(*it);
 		GLuint &count = std::get<1>(*it);
 
-		if (key == keycode && action == GLFW_PRESS)
+		if (key == keycode && action == GLFW_PRESS) {
 			count++;
+			if (!key_press_pending) {
+				key_press_pending = true;
+				key_press_time = std::chrono::steady_clock::now();
+			}
+		}
+	}
+}
+
+static void publish_metrics(struct metrics *m, const struct user_params *params, GLuint num_balls,
+                            const struct gl_debug *gl_debug, const struct frame_fences *fences,
+                            const struct variant_cache *variants)
+{
+	m->live.frames_in_flight  = fences->depth;
+	m->live.fence_wait_us     = fences->wait_us;
+	m->live.fence_wait_us_sum = fences->total_wait_us;
+	for (int i = 0; i < GL_PERF_NUM_CATEGORIES; i++)
+		m->live.gl_perf_messages[i] = gl_debug->total_perf[i];
+	m->live.gl_errors = gl_debug->total_errors;
+	m->live.uniform_calls = 0;
+	m->live.uniform_calls_avoided = 0;
+	for (auto it = variants->variants.begin(); it != variants->variants.end(); ++it) {
+		m->live.uniform_calls += (*it)->uniforms.cache.calls;
+		m->live.uniform_calls_avoided += (*it)->uniforms.cache.avoided;
 	}
+
+	m->live.num_balls           = num_balls;
+	m->live.tail_critical_value = params->tail_critical_value;
+	m->live.friction            = params->friction;
+	m->live.do_draw             = params->do_draw;
+	m->live.limit_time          = params->limit_time;
+	m->live.debug_mode          = params->debug_mode;
+	metrics_publish(m);
+}
+
+static void finish_bench(struct bench_run *bench, const struct options *opts)
+{
+	std::string json;
+
+	bench->commit     = PH_GIT_COMMIT;
+	bench->cpu        = bench_cpu_model();
+	bench->renderer   = (const char *)glGetString(GL_RENDERER);
+	bench->gl_version = (const char *)glGetString(GL_VERSION);
+
+	json = bench_run_to_json(bench);
+	printf("%s\n", json.c_str());
+	bench_append_result(opts->bench_results, json);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
 	int rv = 0;
 	GLenum err;
-	GLuint prg, vao;
+	GLuint prg, hud_prg, fallback_prg = 0, vao;
+	struct variant_cache variants;
+	struct variant_key variant_key, generic_key, atlas_key;
+	struct variant *generic, *atlas_variant;
+	struct ball_uniforms fallback_uniforms, *uniforms;
+	struct shader_watch shader_watch = { -1 };
+	struct program_reload hud_reload, compute_reload, tilebin_reload, upscale_reload, edge_aa_reload;
+	GLuint new_prg, compute_prg = 0;
+	struct ball_uniforms compute_uniforms;
+	struct compute_renderer compute;
+	struct tilebin tilebin;
+	bool use_compute;
+	struct dynres dynres;
+	struct edge_aa edge_aa;
+	int draw_width, draw_height;
+	struct recorder rec = {};
+	struct frame_export frame_export;
+	bool exporting = false;
 	float time;
 	struct user_params params;
+	struct options opts;
+	struct gpu_timer gpu_timer, hud_timer;
+	struct frame_stats frame_stats = {}, avg_stats = {};
+	struct stage_clock stage_clock;
+	struct shading_stats shading_stats;
+	struct hud hud;
+	struct hud_info hud_info;
+	struct bench_run bench;
+	struct metrics metrics;
+	struct gl_debug gl_debug;
+	struct ball_versions versions = {};
+	struct frame_fences fences;
+	struct live_params live_params;
+	struct key_latency latency = {};
+	std::chrono::steady_clock::time_point press_time;
+	GLuint slot;
+	unsigned long long frame = 0;
+	unsigned gl_perf_frame;
+	bool benchmarking, recording, still, thumbnails, offline;
+	float gpu_us;
+	struct shard_job job;
+	struct shard_claim claim;
+	bool shard_done = false;
+	unsigned sim_step;
+	struct wall wall = {};
+	bool wall_renderer;
+	const struct wall_state *wall_state;
+	float view_rect[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+	if (parse_options(argc, argv, &opts) != 0)
+		return 1;
+
+	if (opts.compare_base != NULL)
+		return bench_compare(opts.bench_results, opts.compare_base,
+		                     opts.compare_head, opts.compare_threshold);
+
+	if (opts.half_report > 0)
+		return half_report(opts.seed_given ? opts.seed : 0, opts.half_report, BALL_COUNT,
+		                   params.tail_critical_value);
+
+	if (opts.coordinate_dir != NULL) {
+		job.record = opts.record;
+		job.seed = opts.seed_given ? opts.seed : std::chrono::steady_clock::now().time_since_epoch().count();
+		job.shard_frames = opts.shard_frames;
+		job.output = opts.record.path;
+		job.compute = opts.compute;
+		job.edge_aa = opts.edge_aa;
+		job.half = opts.half;
+		job.dynamic_resolution = opts.dynamic_resolution;
+		job.shader_dir = opts.shader_dir != NULL ? opts.shader_dir : "";
+		if (access((std::string(opts.coordinate_dir) + "/manifest").c_str(), F_OK) != 0 &&
+		    (opts.record.frames == 0 || opts.record.width == 0)) {
+			fprintf(stderr, "A new job needs --record and --record-size\n");
+			return 1;
+		}
+		if (shard_job_create(opts.coordinate_dir, &job) != 0)
+			return 1;
+		return shard_coordinate(opts.coordinate_dir, "/proc/self/exe", opts.workers);
+	}
+
+	// A worker is a recording of one shard
+	if (opts.worker_dir != NULL) {
+		if (shard_job_read(opts.worker_dir, &job) != 0)
+			return 1;
+		rv = shard_claim_next(opts.worker_dir, &job, &claim);
+		if (rv != 0)
+			return rv;
+		fprintf(stderr, "Rendering frames %u to %u\n", claim.first, claim.first + claim.frames - 1);
+		opts.record = job.record;
+		opts.record.frames = claim.frames;
+		opts.record.path = claim.part_path.c_str();
+		opts.seed_given = true;
+		opts.seed = job.seed;
+		opts.compute = job.compute;
+		opts.edge_aa = job.edge_aa;
+		opts.half = job.half;
+		opts.dynamic_resolution = job.dynamic_resolution;
+		opts.shader_dir = job.shader_dir.empty() ? NULL : job.shader_dir.c_str();
+	}
+	benchmarking = opts.bench_frames > 0;
+	recording = opts.record.frames > 0;
+	still = opts.still.path != NULL;
+	thumbnails = opts.thumbnails.path != NULL;
+	offline = recording || still || thumbnails;
+	shader_dir = opts.shader_dir;
+	params.compute = opts.compute;
+	params.edge_aa = opts.edge_aa;
 
 	GLFWmonitor *monitor;
 	const GLFWvidmode *mode;
@@ -546,12 +1629,9 @@ int main(void)
 	float us = 0.0f;
 	float step_per_us, target_frametime_us;
 	auto last_frame = std::chrono::steady_clock::now();
-	GLuint rndseed = last_frame.time_since_epoch().count();
+	GLuint rndseed = opts.seed_given ? opts.seed : last_frame.time_since_epoch().count();
 	std::minstd_rand rndgen(rndseed);
 
-	std::uniform_real_distribution<float> startingtime_distr(1e3f, 2e3f);
-	time = startingtime_distr(rndgen);
-
 	GLuint num_balls = BALL_COUNT;
 
 	std::vector<struct vec3> ball_pos_rad(num_balls);
@@ -560,13 +1640,63 @@ int main(void)
 	std::vector<struct vec4> ball_params(num_balls);
 	std::vector<float> ball_hue_velocity(num_balls);
 	std::vector<struct rwp_vs> ball_rwp_velocity(num_balls);
+	struct sim_state sim = {
+		time, rndgen, ball_pos_rad, ball_color, ball_velocity,
+		ball_params, ball_hue_velocity, ball_rwp_velocity,
+	};
+
+	if (opts.metrics_socket != NULL && metrics_start(&metrics, opts.metrics_socket) != 0)
+		return 1;
 
 	glfwInit();
 	monitor = glfwGetPrimaryMonitor();
+	// The parts of a wall run side by side, each on a projector of its own
+	if (opts.wall_monitor > 0) {
+		int count;
+		GLFWmonitor **monitors = glfwGetMonitors(&count);
+		if (opts.wall_monitor < count)
+			monitor = monitors[opts.wall_monitor];
+		else
+			fprintf(stderr, "No monitor %d, using the primary\n", opts.wall_monitor);
+	}
 	mode    = glfwGetVideoMode(monitor);
 
-	step_per_us = STEP_PER_US_1HZ * (float)mode->refreshRate;
-	target_frametime_us = 1e6f / (float)mode->refreshRate;
+	// A recording steps as if it was shown live on a display of its frame
+	// rate, but always by exactly one frame
+	if (recording) {
+		if (opts.record.width == 0) {
+			opts.record.width = mode->width;
+			opts.record.height = mode->height;
+		}
+		step_per_us = STEP_PER_US_1HZ * (float)opts.record.fps;
+		target_frametime_us = 1e6f / (float)opts.record.fps;
+		params.limit_time = false;
+		if (!opts.seed_given)
+			fprintf(stderr, "Recording with --seed %u\n", rndseed);
+	} else {
+		step_per_us = STEP_PER_US_1HZ * (float)mode->refreshRate;
+		target_frametime_us = 1e6f / (float)mode->refreshRate;
+	}
+
+	// Stills are always drawn by fs.glsl, in tiles
+	if (still) {
+		if (opts.still.width == 0) {
+			opts.still.width = mode->width;
+			opts.still.height = mode->height;
+		}
+		params.limit_time = false;
+		params.compute = false;
+		params.edge_aa = false;
+		if (!opts.seed_given)
+			fprintf(stderr, "Rendering with --seed %u\n", rndseed);
+	}
+
+	// Thumbnails are cells of an atlas, drawn like stills
+	if (thumbnails) {
+		canvas_aspect_ratio = (float)opts.thumbnails.cell_width / (float)opts.thumbnails.cell_height;
+		params.limit_time = false;
+		params.compute = false;
+	}
 
 	glfwWindowHint(GLFW_RED_BITS, mode->redBits);
 	glfwWindowHint(GLFW_GREEN_BITS, mode->greenBits);
@@ -576,12 +1706,49 @@ int main(void)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	GLFWwindow *window = glfwCreateWindow(mode->width, mode->height, "mä nään värejä", monitor, NULL);
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, opts.gl_debug ? GLFW_TRUE : GLFW_FALSE);
+	// Offline rendering draws into framebuffers of its own, the window is
+	// only there for the context
+	glfwWindowHint(GLFW_VISIBLE, offline ? GLFW_FALSE : GLFW_TRUE);
+	GLFWwindow *window = offline
+		? glfwCreateWindow(OFFLINE_WINDOW_SIZE, OFFLINE_WINDOW_SIZE, "mä nään värejä", NULL, NULL)
+		: glfwCreateWindow(mode->width, mode->height, "mä nään värejä", monitor, NULL);
 
 	if (window == NULL) {
 		rv = 1;
 		goto out;
 	}
+
+	// Each part of a wall is drawn by fs.glsl with its view_rect, and in the
+	// aspect ratio of the whole canvas
+	if (opts.wall != NULL) {
+		if (wall_init(&wall, opts.wall, opts.wall_authority,
+		              opts.wall_canvas_width > 0 ? opts.wall_canvas_width : mode->width,
+		              opts.wall_canvas_height > 0 ? opts.wall_canvas_height : mode->height) != 0) {
+			rv = 1;
+			goto out_terminate;
+		}
+		int cw = wall.shm->canvas_width, ch = wall.shm->canvas_height;
+		int *r = opts.wall_rect;
+		if (r[2] == 0) {
+			r[2] = cw;
+			r[3] = ch;
+		}
+		if (r[0] + r[2] > cw || r[1] + r[3] > ch) {
+			fprintf(stderr, "%d,%d,%d,%d is not within the %dx%d canvas\n",
+			        r[0], r[1], r[2], r[3], cw, ch);
+			rv = 1;
+			goto out_terminate;
+		}
+		view_rect[0] = (float)r[0] / (float)cw;
+		view_rect[1] = 1.0f - (float)(r[1] + r[3]) / (float)ch;
+		view_rect[2] = (float)r[2] / (float)cw;
+		view_rect[3] = (float)r[3] / (float)ch;
+		canvas_aspect_ratio = (float)cw / (float)ch;
+		params.compute = false;
+	}
+	wall_renderer = wall.shm != NULL && !wall.authority;
+
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GLFW_TRUE);
 	glfwMakeContextCurrent(window);
@@ -593,61 +1760,404 @@ int main(void)
 		fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
 		goto out_terminate;
 	}
-
-	prg = create_shader_program("vs.glsl", "fs.glsl");
-	if (prg == 0) {
-		fprintf(stderr, "Failed to create shader program\n");
+	gl_debug_init(&gl_debug, opts.gl_debug);
+	if (opts.half && !have_half_floats())
+		fprintf(stderr, "No half floats in shaders here, --half mixes in full precision\n");
+	progcache_init(opts.program_cache);
+
+	// The compiler gets to work while everything else is set up
+	progbuild_init(window);
+	if (load_variant_sources(&variants, false) != 0)
 		goto out_terminate;
+	generic_variant_key(&generic_key);
+	variant_cache_get(&variants, &generic_key);
+	program_reload_init(&hud_reload, "hud_vs.glsl", "hud_fs.glsl");
+	program_reload_start(&hud_reload);
+	program_reload_init_compute(&compute_reload, "field_cs.glsl");
+	program_reload_start(&compute_reload);
+	program_reload_init_compute(&tilebin_reload, "tilebin_cs.glsl");
+	program_reload_start(&tilebin_reload);
+	program_reload_init(&upscale_reload, "vs.glsl", "upscale_fs.glsl");
+	if (opts.dynamic_resolution && !offline)
+		program_reload_start(&upscale_reload);
+	program_reload_init(&edge_aa_reload, "vs.glsl", "edge_aa_mark_fs.glsl");
+	program_reload_start(&edge_aa_reload);
+
+	if (benchmarking) {
+		// Measure the render loop, not the display
+		glfwSwapInterval(0);
+		params.limit_time = false;
+
+		struct bench_config bench_config = {};
+		bench_config.frames              = opts.bench_frames;
+		bench_config.warmup              = opts.bench_warmup;
+		bench_config.num_balls           = num_balls;
+		bench_config.width               = mode->width;
+		bench_config.height              = mode->height;
+		bench_config.seed                = rndseed;
+		bench_config.frames_in_flight    = opts.frames_in_flight;
+		bench_config.tail_critical_value = params.tail_critical_value;
+		bench_config.friction            = params.friction;
+		bench_config.compute             = params.compute;
+		bench_run_init(&bench, &bench_config);
 	}
+	gpu_timer_init(&gpu_timer);
+	frame_fences_init(&fences, opts.frames_in_flight);
+	if (live_params_init(&live_params, fences.depth) != 0)
+		goto out_terminate;
+
+	gpu_timer_init(&hud_timer);
+	shading_stats_init(&shading_stats);
+	compute_renderer_init(&compute);
+	tilebin_init(&tilebin);
+	dynres_init(&dynres, opts.dynamic_resolution && !offline);
+	edge_aa_init(&edge_aa);
+
 	gen_vao(&vao);
-	get_uniform_locs(prg);
+	if (offline)
+		glfwSwapInterval(0);
+	if (recording) {
+		if (recorder_init(&rec, &(opts.record)) != 0) {
+			rv = 1;
+			goto out_terminate;
+		}
+		dynres.out_fbo = rec.fbo;
+		resize_callback(window, opts.record.width, opts.record.height);
+	} else if (still) {
+		resize_callback(window, opts.still.width, opts.still.height);
+	} else if (thumbnails) {
+		resize_callback(window, opts.thumbnails.cell_width, opts.thumbnails.cell_height);
+	} else {
+		resize_callback(window, mode->width, mode->height);
+		exporting = opts.export_socket != NULL &&
+		            frame_export_init(&frame_export, opts.export_socket, fb_width, fb_height) == 0;
+	}
 
-	resize_callback(window, mode->width, mode->height);
+	random_scene(&sim);
 
-	for (GLuint i = 0; i < num_balls; i++) {
-		random_ball_pos_rad(ball_pos_rad.data() + i, rndgen);
-		random_saturated_color(ball_color.data() + i, rndgen);
-		random_ball_params(ball_params.data() + i, rndgen);
-		random_ball_hue_velocity(ball_hue_velocity.data() + i, rndgen);
-		random_ball_rwp_velocity(ball_rwp_velocity.data() + i, rndgen);
+	// Workers only simulate what no snapshot covers yet
+	if (opts.worker_dir != NULL) {
+		sim_step = shard_nearest_snapshot(opts.worker_dir, claim.first);
+		if (sim_step > 0 &&
+		    load_snapshot(shard_snapshot_path(opts.worker_dir, sim_step), &sim) != 0)
+			goto out_terminate;
+		for (; sim_step < claim.first; sim_step++)
+			simulate(&sim, step_per_us * target_frametime_us, params.friction);
 	}
-	glUseProgram(prg);
-	update_num_balls(prg, num_balls);
-	update_ball_color(prg, num_balls, ball_color.data());
+
+	hud_prg = program_reload_wait(&hud_reload);
+	if (hud_prg == 0) {
+		fprintf(stderr, "Failed to create HUD shader program\n");
+		goto out_terminate;
+	}
+	hud_init(&hud, hud_prg);
+
+	select_variant_key(&variant_key, ball_pos_rad, ball_params, params.tail_critical_value,
+	                   params.edge_aa, opts.half);
+	variant_cache_get(&variants, &variant_key);
+	if (thumbnails) {
+		atlas_key = generic_key;
+		atlas_key.num_balls = num_balls;
+		atlas_key.atlas = true;
+		variant_cache_get(&variants, &atlas_key);
+	}
+
+	// Benchmarks measure the real thing and offline renders have to come
+	// out the same every time. Otherwise the first frames may be drawn with
+	// a simpler program if the compiler is not done yet
+	if (benchmarking || offline) {
+		variant_cache_wait(&variants);
+		if (params.compute && compute_reload.building)
+			progbuild_wait(&(compute_reload.build));
+		if (params.edge_aa) {
+			new_prg = program_reload_wait(&edge_aa_reload);
+			if (new_prg != 0)
+				edge_aa_set_program(&edge_aa, new_prg);
+		}
+	}
+	variant_cache_poll(&variants);
+	generic = variant_cache_get(&variants, &generic_key);
+	if (generic->prg == 0 && !generic->failed) {
+		fallback_prg = create_shader_program("vs.glsl", "fallback_fs.glsl");
+		if (fallback_prg == 0)
+			variant_cache_wait(&variants);
+	}
+	if (generic->prg == 0 && generic->failed) {
+		fprintf(stderr, "Failed to create shader program\n");
+		goto out_terminate;
+	}
+	if (fallback_prg != 0) {
+		get_uniform_locs(&fallback_uniforms, fallback_prg);
+		update_num_balls(&fallback_uniforms, num_balls);
+	}
+
+	// Shaders loaded from disk are rebuilt whenever they change there
+	if (shader_dir != NULL && shader_watch_init(&shader_watch, shader_dir) != 0)
+		fprintf(stderr, "Shaders in %s will not be reloaded\n", shader_dir);
 
 	while (!glfwWindowShouldClose(window)) {
 		float step;
+		stage_clock_start(&stage_clock);
+		gl_debug_new_frame(&gl_debug, frame++);
+		slot = frame_fences_wait(&fences);
+		stage_clock_lap(&stage_clock, &frame_stats, STAGE_WAIT);
+		if (latency.pending && fences.completed > latency.frame) {
+			auto now = std::chrono::steady_clock::now();
+			latency.ms = std::chrono::duration<float, std::milli>(now - latency.press).count();
+			latency.frames = latency.ms * 1e3f / target_frametime_us;
+			latency.pending = false;
+		}
+
 		if (params.limit_time)
 			step = step_per_us * us;
 		else
 			step = step_per_us * target_frametime_us;
 
-		time += step;
-		move_balls(ball_pos_rad, ball_velocity, rndgen, step, params.friction);
-		move_ball_hues(ball_color, ball_hue_velocity, step);
-		rotate_warp_balls(ball_params, ball_rwp_velocity, time);
-		update_aspect_ratio_maybe(prg);
+		if (wall_renderer) {
+			// Keeps showing the last frame if the authority is gone
+			wall_state = wall_wait_state(&wall);
+			if (wall_state != NULL) {
+				receive_wall_state(wall_state, &sim, &(params.tail_critical_value));
+				versions.pos_rad++;
+				versions.color++;
+				versions.params++;
+			}
+		} else {
+			simulate(&sim, step, params.friction);
+			if (metrics.running)
+				metrics.live.sim_steps++;
+			if (step != 0.0f) {
+				versions.pos_rad++;
+				versions.color++;
+				versions.params++;
+			}
+			if (wall.authority) {
+				publish_wall_state(wall_next_state(&wall), &sim, num_balls,
+				                   params.tail_critical_value);
+				wall_publish(&wall);
+			}
+		}
+		stage_clock_lap(&stage_clock, &frame_stats, STAGE_SIMULATE);
+
+		if (shader_watch.fd >= 0 && shader_watch_poll(&shader_watch)) {
+			load_variant_sources(&variants, true);
+			program_reload_start(&hud_reload);
+			program_reload_start(&compute_reload);
+			program_reload_start(&tilebin_reload);
+			if (opts.dynamic_resolution)
+				program_reload_start(&upscale_reload);
+			program_reload_start(&edge_aa_reload);
+		}
+		new_prg = program_reload_poll(&hud_reload);
+		if (new_prg != 0)
+			hud_set_program(&hud, new_prg);
+		new_prg = program_reload_poll(&compute_reload);
+		if (new_prg != 0) {
+			glDeleteProgram(compute_prg);
+			compute_prg = new_prg;
+			get_uniform_locs(&compute_uniforms, compute_prg);
+			update_num_balls(&compute_uniforms, num_balls);
+		}
+		new_prg = program_reload_poll(&tilebin_reload);
+		if (new_prg != 0)
+			tilebin_set_program(&tilebin, new_prg);
+		new_prg = program_reload_poll(&upscale_reload);
+		if (new_prg != 0)
+			dynres_set_program(&dynres, new_prg);
+		new_prg = program_reload_poll(&edge_aa_reload);
+		if (new_prg != 0)
+			edge_aa_set_program(&edge_aa, new_prg);
+
+		variant_cache_poll(&variants);
+		select_variant_key(&variant_key, ball_pos_rad, ball_params, params.tail_critical_value,
+		                   params.edge_aa, opts.half);
+		prg = pick_program(&variants, &variant_key, fallback_prg, &fallback_uniforms,
+		                   num_balls, &uniforms);
+		if (prg == 0) {
+			fprintf(stderr, "Failed to create shader program\n");
+			rv = 1;
+			break;
+		}
+		// Only once nothing can fall back to it any more
+		if (fallback_prg != 0 && generic->prg != 0) {
+			glDeleteProgram(fallback_prg);
+			fallback_prg = 0;
+		}
+
+		// Until the compute program is built, the fragment path stands in
+		use_compute = params.compute && compute_prg != 0;
+		if (use_compute) {
+			prg = compute_prg;
+			uniforms = &compute_uniforms;
+		}
 
-		update_ball_pos_rad(prg, num_balls, ball_pos_rad.data());
-		update_ball_color(prg, num_balls, ball_color.data());
-		update_ball_params(prg, num_balls, ball_params.data());
-		update_tail_cv(prg, &params);
+		update_ball_pos_rad(uniforms, num_balls, ball_pos_rad.data(), versions.pos_rad);
+		update_ball_color(uniforms, num_balls, ball_color.data(), versions.color);
+		update_ball_params(uniforms, num_balls, ball_params.data(), versions.params);
+		if (wall.shm != NULL)
+			update_view_rect(uniforms, view_rect);
+		stage_clock_lap(&stage_clock, &frame_stats, STAGE_UPLOAD);
 
+		// Input is handled as late as possible, and whatever the shader
+		// needs from it goes to this frame's slot of live_params
 		glfwPollEvents();
-		process_input(window, &params);
+		if (process_input(window, &params, &press_time) && !latency.pending) {
+			latency.pending = true;
+			latency.press = press_time;
+			latency.frame = fences.frame;
+		}
+		latch_live_params(&live_params, slot, &params);
+		stage_clock_lap(&stage_clock, &frame_stats, STAGE_INPUT);
+		if (still && frame >= opts.still.frame) {
+			rv = render_still(&(opts.still), prg, vao);
+			break;
+		}
+		if (thumbnails) {
+			atlas_variant = variant_cache_get(&variants, &atlas_key);
+			if (atlas_variant->prg == 0) {
+				fprintf(stderr, "Failed to create thumbnail shader program\n");
+				rv = 1;
+				break;
+			}
+			rv = render_thumbnails(&(opts.thumbnails), rndseed, atlas_variant->prg, vao,
+			                       step_per_us * target_frametime_us, params.friction, num_balls);
+			break;
+		}
 		if (params.do_draw) {
-			glBindVertexArray(vao);
-			draw();
+			gpu_timer_begin(&gpu_timer);
+			dynres_begin(&dynres, fb_width, fb_height, &draw_width, &draw_height);
+			edge_aa_begin(&edge_aa, draw_width, draw_height, params.edge_aa && !use_compute);
+			if (params.debug_mode != DEBUG_OFF)
+				shading_stats_begin(&shading_stats);
+			if (use_compute) {
+				tilebin_update(&tilebin, (const GLfloat *)ball_pos_rad.data(), num_balls,
+				               draw_width, draw_height, aspect_ratio, params.tail_critical_value);
+				tilebin_upload(&tilebin);
+				compute_renderer_draw(&compute, prg, draw_width, draw_height);
+			} else {
+				glUseProgram(prg);
+				glBindVertexArray(vao);
+				draw();
+			}
+			edge_aa_end(&edge_aa, prg, uniforms->aa_pass_loc);
+			shading_stats_end(&shading_stats);
+			dynres_end(&dynres);
+			gpu_timer_end(&gpu_timer);
+
+			// Before the HUD, which is only for the screen
+			if (exporting)
+				frame_export_frame(&frame_export, fb_width, fb_height);
+
+			if (recording && recorder_capture(&rec) != 0) {
+				rv = 1;
+				break;
+			}
+
+			if (params.show_hud) {
+				gpu_timer_begin(&hud_timer);
+				hud_draw(&hud, fb_width, fb_height);
+				gpu_timer_end(&hud_timer);
+			}
 		}
-		if (params.limit_time || params.do_draw)
+		stage_clock_lap(&stage_clock, &frame_stats, STAGE_DRAW);
+		if (wall.shm != NULL)
+			wall_barrier(&wall);
+		if (!offline && (params.limit_time || params.do_draw))
 			glfwSwapBuffers(window);
+		frame_fences_submit(&fences);
+		stage_clock_lap(&stage_clock, &frame_stats, STAGE_SWAP);
+
+		while (gpu_timer_result(&gpu_timer, &gpu_us)) {
+			frame_stats.gpu_us = gpu_us;
+			dynres_update(&dynres, gpu_us, target_frametime_us);
+			if (metrics.running)
+				metrics_add_gpu_time(&metrics, gpu_us);
+			if (benchmarking)
+				bench_add_gpu_time(&bench, gpu_us);
+		}
+		while (gpu_timer_result(&hud_timer, &gpu_us))
+			frame_stats.hud_gpu_us = gpu_us;
+		while (shading_stats_poll(&shading_stats))
+			;
 
 		auto this_frame = std::chrono::steady_clock::now();
 		us = std::chrono::duration_cast<std::chrono::microseconds>(this_frame - last_frame).count();
 		last_frame = this_frame;
+
+		gl_perf_frame = 0;
+		for (int i = 0; i < GL_PERF_NUM_CATEGORIES; i++)
+			gl_perf_frame += gl_debug.frame_perf[i];
+
+		frame_stats.frame_us = us;
+		frame_stats_smooth(&avg_stats, &frame_stats);
+		if (metrics.running) {
+			metrics_add_frame(&metrics, us, target_frametime_us);
+			metrics.live.gl_perf_last_frame = gl_perf_frame;
+			metrics.live.key_latency_us = latency.ms * 1e3f;
+			publish_metrics(&metrics, &params, num_balls, &gl_debug, &fences, &variants);
+		}
+		if (params.show_hud) {
+			hud_info.stats               = &avg_stats;
+			hud_info.num_balls           = num_balls;
+			hud_info.tail_critical_value = params.tail_critical_value;
+			hud_info.friction            = params.friction;
+			hud_info.gl_perf_messages    = gl_perf_frame;
+			hud_info.key_latency_ms      = latency.ms;
+			hud_info.key_latency_frames  = latency.frames;
+			hud_info.debug_mode          = params.debug_mode;
+			hud_info.compute             = use_compute;
+			hud_info.edge_aa             = edge_aa.width > 0;
+			hud_info.render_scale        = dynres.prg != 0 ? dynres.scale : 1.0f;
+			hud_info.shading             = &shading_stats;
+			hud_update(&hud, &hud_info, us);
+		}
+
+		if (benchmarking && bench_add_frame(&bench, us)) {
+			finish_bench(&bench, &opts);
+			break;
+		}
+		if (recording && recorder_done(&rec))
+			break;
+		if (opts.worker_dir != NULL)
+			shard_touch(&claim);
+	}
+	shader_watch_destroy(&shader_watch);
+	if (recording)
+		recorder_destroy(&rec);
+	if (exporting)
+		frame_export_destroy(&frame_export);
+
+	// The next shard starts where this one ended
+	if (opts.worker_dir != NULL && rv == 0 && recorder_done(&rec)) {
+		sim_step = claim.first + claim.frames;
+		if (sim_step < job.record.frames &&
+		    save_snapshot(shard_snapshot_path(opts.worker_dir, sim_step), &sim) != 0)
+			fprintf(stderr, "Failed to save a snapshot at step %u\n", sim_step);
+		shard_done = shard_finish(&claim) == 0;
+		if (!shard_done)
+			rv = 1;
 	}
+	edge_aa_destroy(&edge_aa);
+	dynres_destroy(&dynres);
+	tilebin_destroy(&tilebin);
+	compute_renderer_destroy(&compute);
+	glDeleteProgram(compute_prg);
+	live_params_destroy(&live_params);
+	frame_fences_destroy(&fences);
+	shading_stats_destroy(&shading_stats);
+	gpu_timer_destroy(&hud_timer);
+	gpu_timer_destroy(&gpu_timer);
+	hud_destroy(&hud);
 out_terminate:
+	progbuild_destroy();
+	variant_cache_destroy(&variants);
 	glfwTerminate();
 out:
+	metrics_stop(&metrics);
+	wall_destroy(&wall);
+	if (opts.worker_dir != NULL && !shard_done) {
+		shard_abandon(&claim);
+		rv = 1;
+	}
 	return rv;
 }
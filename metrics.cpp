@@ -0,0 +1,311 @@
+#include <cerrno>
+#include <cstdarg>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+// How long a client gets to send its request before it is answered anyway
+#define REQUEST_TIMEOUT_MS 100
+// How long a client that does not read gets before it is dropped
+#define SEND_TIMEOUT_MS 100
+#define REQUEST_SZ 1024
+
+static const float frame_bucket_us[] = METRICS_FRAME_BUCKETS_US;
+static const float quantiles[] = { 0.5f, 0.9f, 0.99f, 1.0f };
+
+static void append(std::string &dst, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void append(std::string &dst, const char *fmt, ...)
+{
+	char buf[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	dst += buf;
+}
+
+static void format_metrics(const struct metrics_snapshot *s, std::string &out)
+{
+	std::vector<float> window;
+	uint64_t cumulative = 0;
+	size_t filled = std::min(s->frames, (uint64_t)METRICS_WINDOW);
+
+	append(out, "# HELP ph_frames_total Frames rendered.\n"
+	            "# TYPE ph_frames_total counter\n"
+	            "ph_frames_total %llu\n", (unsigned long long)s->frames);
+	append(out, "# HELP ph_sim_steps_total Simulation steps taken.\n"
+	            "# TYPE ph_sim_steps_total counter\n"
+	            "ph_sim_steps_total %llu\n", (unsigned long long)s->sim_steps);
+	append(out, "# HELP ph_dropped_frames_total Display refreshes missed.\n"
+	            "# TYPE ph_dropped_frames_total counter\n"
+	            "ph_dropped_frames_total %llu\n", (unsigned long long)s->dropped_frames);
+
+	append(out, "# HELP ph_frame_time_seconds Time between frames.\n"
+	            "# TYPE ph_frame_time_seconds histogram\n");
+	for (int i = 0; i < METRICS_NUM_FRAME_BUCKETS; i++) {
+		cumulative += s->frame_buckets[i];
+		if (i < METRICS_NUM_FRAME_BUCKETS - 1)
+			append(out, "ph_frame_time_seconds_bucket{le=\"%g\"} %llu\n",
+			       frame_bucket_us[i] * 1e-6f, (unsigned long long)cumulative);
+		else
+			append(out, "ph_frame_time_seconds_bucket{le=\"+Inf\"} %llu\n",
+			       (unsigned long long)cumulative);
+	}
+	append(out, "ph_frame_time_seconds_sum %.6f\n", s->frame_us_sum * 1e-6);
+	append(out, "ph_frame_time_seconds_count %llu\n", (unsigned long long)s->frames);
+
+	window.assign(s->frame_window_us, s->frame_window_us + filled);
+	std::sort(window.begin(), window.end());
+	append(out, "# HELP ph_recent_frame_time_seconds Time between frames over the last %d frames.\n"
+	            "# TYPE ph_recent_frame_time_seconds summary\n", METRICS_WINDOW);
+	for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]) && filled > 0; i++) {
+		size_t n = std::min((size_t)(quantiles[i] * filled), filled - 1);
+		append(out, "ph_recent_frame_time_seconds{quantile=\"%g\"} %.6f\n",
+		       quantiles[i], window[n] * 1e-6f);
+	}
+
+	append(out, "# HELP ph_gpu_time_seconds GPU time of the latest timed frame.\n"
+	            "# TYPE ph_gpu_time_seconds gauge\n"
+	            "ph_gpu_time_seconds %.6f\n", s->gpu_us * 1e-6f);
+	append(out, "# HELP ph_gpu_time_seconds_total GPU time of all timed frames.\n"
+	            "# TYPE ph_gpu_time_seconds_total counter\n"
+	            "ph_gpu_time_seconds_total %.6f\n", s->gpu_us_sum * 1e-6);
+	append(out, "# HELP ph_gpu_timed_frames_total Frames with a GPU time.\n"
+	            "# TYPE ph_gpu_timed_frames_total counter\n"
+	            "ph_gpu_timed_frames_total %llu\n", (unsigned long long)s->gpu_frames);
+
+	append(out, "# HELP ph_key_latency_seconds From the latest key press to the GPU finishing its first frame.\n"
+	            "# TYPE ph_key_latency_seconds gauge\n"
+	            "ph_key_latency_seconds %.6f\n", s->key_latency_us * 1e-6f);
+	append(out, "# HELP ph_frames_in_flight Frames the GPU may lag behind.\n"
+	            "# TYPE ph_frames_in_flight gauge\n"
+	            "ph_frames_in_flight %u\n", s->frames_in_flight);
+	append(out, "# HELP ph_fence_wait_seconds Time the latest frame waited for the GPU.\n"
+	            "# TYPE ph_fence_wait_seconds gauge\n"
+	            "ph_fence_wait_seconds %.6f\n", s->fence_wait_us * 1e-6f);
+	append(out, "# HELP ph_fence_wait_seconds_total Time spent waiting for the GPU.\n"
+	            "# TYPE ph_fence_wait_seconds_total counter\n"
+	            "ph_fence_wait_seconds_total %.6f\n", s->fence_wait_us_sum * 1e-6);
+
+	append(out, "# HELP ph_gl_perf_messages_total Driver performance warnings.\n"
+	            "# TYPE ph_gl_perf_messages_total counter\n");
+	for (int i = 0; i < GL_PERF_NUM_CATEGORIES; i++)
+		append(out, "ph_gl_perf_messages_total{category=\"%s\"} %llu\n",
+		       gl_perf_category_name((enum gl_perf_category)i),
+		       (unsigned long long)s->gl_perf_messages[i]);
+	append(out, "# HELP ph_gl_perf_messages_last_frame Driver performance warnings in the latest frame.\n"
+	            "# TYPE ph_gl_perf_messages_last_frame gauge\n"
+	            "ph_gl_perf_messages_last_frame %u\n", s->gl_perf_last_frame);
+	append(out, "# HELP ph_gl_errors_total GL errors reported through KHR_debug.\n"
+	            "# TYPE ph_gl_errors_total counter\n"
+	            "ph_gl_errors_total %llu\n", (unsigned long long)s->gl_errors);
+
+	append(out, "# HELP ph_uniform_calls_total glProgramUniform calls made.\n"
+	            "# TYPE ph_uniform_calls_total counter\n"
+	            "ph_uniform_calls_total %llu\n", (unsigned long long)s->uniform_calls);
+	append(out, "# HELP ph_uniform_calls_avoided_total glProgramUniform calls skipped as redundant.\n"
+	            "# TYPE ph_uniform_calls_avoided_total counter\n"
+	            "ph_uniform_calls_avoided_total %llu\n", (unsigned long long)s->uniform_calls_avoided);
+
+	append(out, "# HELP ph_num_balls Balls in the scene.\n"
+	            "# TYPE ph_num_balls gauge\n"
+	            "ph_num_balls %u\n", s->num_balls);
+	append(out, "# HELP ph_tail_critical_value User parameter tail_critical_value.\n"
+	            "# TYPE ph_tail_critical_value gauge\n"
+	            "ph_tail_critical_value %g\n", s->tail_critical_value);
+	append(out, "# HELP ph_friction User parameter friction.\n"
+	            "# TYPE ph_friction gauge\n"
+	            "ph_friction %g\n", s->friction);
+	append(out, "# HELP ph_do_draw Whether drawing is on.\n"
+	            "# TYPE ph_do_draw gauge\n"
+	            "ph_do_draw %d\n", s->do_draw ? 1 : 0);
+	append(out, "# HELP ph_limit_time Whether the simulation follows real time.\n"
+	            "# TYPE ph_limit_time gauge\n"
+	            "ph_limit_time %d\n", s->limit_time ? 1 : 0);
+	append(out, "# HELP ph_debug_mode Debug heatmap mode, 0 is off.\n"
+	            "# TYPE ph_debug_mode gauge\n"
+	            "ph_debug_mode %u\n", s->debug_mode);
+}
+
+static void send_all(int fd, const std::string &s)
+{
+	size_t off = 0;
+	while (off < s.size()) {
+		ssize_t n = send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		off += n;
+	}
+}
+
+static void serve_client(struct metrics *m, int fd, struct metrics_snapshot *snap)
+{
+	char req[REQUEST_SZ];
+	ssize_t len = 0;
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	struct timeval send_timeout = { 0, SEND_TIMEOUT_MS * 1000 };
+	std::string body, response;
+
+	// Otherwise a client that never reads would stall every later scrape
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+	if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) > 0)
+		len = recv(fd, req, sizeof(req) - 1, 0);
+
+	{
+		std::lock_guard<std::mutex> lck(m->mtx);
+		*snap = m->shared;
+	}
+	format_metrics(snap, body);
+
+	if (len >= 4 && strncmp(req, "GET ", 4) == 0) {
+		append(response, "HTTP/1.0 200 OK\r\n"
+		                 "Content-Type: text/plain; version=0.0.4\r\n"
+		                 "Content-Length: %zu\r\n\r\n", body.size());
+	}
+	response += body;
+	send_all(fd, response);
+}
+
+static void serve(struct metrics *m)
+{
+	// Too large for the stack of a thread that sits around all day
+	std::vector<struct metrics_snapshot> snap(1);
+	struct pollfd pfds[2] = {
+		{ m->listen_fd,   POLLIN, 0 },
+		{ m->wake_fds[0], POLLIN, 0 },
+	};
+
+	for (;;) {
+		int fd;
+
+		if (poll(pfds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pfds[1].revents != 0)
+			break;
+		if ((pfds[0].revents & POLLIN) == 0)
+			continue;
+
+		fd = accept4(m->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+		serve_client(m, fd, snap.data());
+		close(fd);
+	}
+}
+
+int metrics_start(struct metrics *m, const char *path)
+{
+	int rv = 0;
+	struct sockaddr_un addr = {};
+
+	m->running = false;
+	m->path = path;
+	memset(&(m->live), 0, sizeof(m->live));
+	m->shared = m->live;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Metrics socket path too long: %s\n", path);
+		rv = 1;
+		goto out;
+	}
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	m->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m->listen_fd < 0) {
+		rv = 1;
+		goto out_err;
+	}
+	// A previous run that died leaves its socket behind
+	unlink(path);
+	if (bind(m->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+		goto out_err_close;
+	if (listen(m->listen_fd, 4) != 0)
+		goto out_err_unlink;
+	if (pipe2(m->wake_fds, O_CLOEXEC) != 0)
+		goto out_err_unlink;
+
+	m->thread = std::thread(serve, m);
+	m->running = true;
+	goto out;
+
+out_err_unlink:
+	unlink(path);
+out_err_close:
+	close(m->listen_fd);
+	rv = 1;
+out_err:
+	fprintf(stderr, "Failed to open metrics socket %s: %s\n", path, strerror(errno));
+out:
+	return rv;
+}
+
+void metrics_stop(struct metrics *m)
+{
+	if (!m->running)
+		return;
+
+	ssize_t n = write(m->wake_fds[1], "", 1);
+	(void)n;
+	m->thread.join();
+	close(m->wake_fds[0]);
+	close(m->wake_fds[1]);
+	close(m->listen_fd);
+	unlink(m->path);
+	m->running = false;
+}
+
+void metrics_add_frame(struct metrics *m, float frame_us, float target_frametime_us)
+{
+	struct metrics_snapshot *s = &(m->live);
+	int bucket = 0;
+	float refreshes = std::round(frame_us / target_frametime_us);
+
+	while (bucket < METRICS_NUM_FRAME_BUCKETS - 1 && frame_us > frame_bucket_us[bucket])
+		bucket++;
+
+	s->frame_window_us[s->frames % METRICS_WINDOW] = frame_us;
+	s->frame_buckets[bucket]++;
+	s->frame_us_sum += frame_us;
+	s->frames++;
+	if (refreshes > 1.0f)
+		s->dropped_frames += (uint64_t)refreshes - 1;
+}
+
+void metrics_add_gpu_time(struct metrics *m, float gpu_us)
+{
+	m->live.gpu_us = gpu_us;
+	m->live.gpu_us_sum += gpu_us;
+	m->live.gpu_frames++;
+}
+
+void metrics_publish(struct metrics *m)
+{
+	if (!m->running)
+		return;
+
+	if (m->mtx.try_lock()) {
+		m->shared = m->live;
+		m->mtx.unlock();
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "gldebug.h"
+
+// Upper bounds of the frame time histogram buckets, in microseconds. The
+// last bucket is +Inf
+#define METRICS_FRAME_BUCKETS_US { 2000.0f, 4000.0f, 8000.0f, 12000.0f, 16667.0f, \
+                                   20000.0f, 33333.0f, 50000.0f, 100000.0f }
+#define METRICS_NUM_FRAME_BUCKETS 10
+
+// Quantiles are computed over this many most recent frames
+#define METRICS_WINDOW 1024
+
+struct metrics_snapshot {
+	uint64_t frames;
+	uint64_t sim_steps;
+	uint64_t dropped_frames;
+
+	uint64_t frame_buckets[METRICS_NUM_FRAME_BUCKETS];
+	double frame_us_sum;
+	float frame_window_us[METRICS_WINDOW];
+
+	float key_latency_us;
+
+	double fence_wait_us_sum;
+	float fence_wait_us;
+	unsigned frames_in_flight;
+
+	uint64_t gpu_frames;
+	double gpu_us_sum;
+	float gpu_us;
+
+	// GL_DEBUG_TYPE_PERFORMANCE messages, see gldebug.h
+	uint64_t gl_perf_messages[GL_PERF_NUM_CATEGORIES];
+	unsigned gl_perf_last_frame;
+	uint64_t gl_errors;
+
+	// See uniforms.h
+	uint64_t uniform_calls;
+	uint64_t uniform_calls_avoided;
+
+	unsigned num_balls;
+	float tail_critical_value;
+	float friction;
+	bool do_draw;
+	bool limit_time;
+	unsigned debug_mode;
+};
+
+struct metrics {
+	bool running;
+	const char *path;
+	int listen_fd;
+	int wake_fds[2];
+
+	// Only touched by the render thread
+	struct metrics_snapshot live;
+
+	// Copy of live for the server thread. The render thread only ever
+	// try_locks mtx, so a slow scrape costs it nothing but a stale copy
+	std::mutex mtx;
+	struct metrics_snapshot shared;
+
+	std::thread thread;
+
+	metrics() : running(false), live(), shared() {}
+};
+
+// Listens on a Unix socket at path, answering every connection with the
+// current metrics in Prometheus text format (with an HTTP header if the
+// client sent a GET)
+int  metrics_start(struct metrics *m, const char *path);
+void metrics_stop(struct metrics *m);
+
+// Counts one rendered frame of frame_us. Frames that took longer than one
+// refresh interval count the missed refreshes as dropped
+void metrics_add_frame(struct metrics *m, float frame_us, float target_frametime_us);
+void metrics_add_gpu_time(struct metrics *m, float gpu_us);
+
+// Hands the live values to the server thread if it is not busy with them
+void metrics_publish(struct metrics *m);
+
+#endif
@@ -0,0 +1,172 @@
+#include "perf.h"
+
+#define SMOOTHING 0.05f
+
+void gpu_timer_init(struct gpu_timer *t)
+{
+	glGenQueries(GPU_TIMER_DEPTH, t->queries);
+	t->issued  = 0;
+	t->retired = 0;
+	t->skipped = 0;
+	t->running = false;
+}
+
+void gpu_timer_destroy(struct gpu_timer *t)
+{
+	glDeleteQueries(GPU_TIMER_DEPTH, t->queries);
+}
+
+bool gpu_timer_begin(struct gpu_timer *t)
+{
+	if (t->issued - t->retired >= GPU_TIMER_DEPTH) {
+		t->skipped++;
+		return false;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, t->queries[t->issued % GPU_TIMER_DEPTH]);
+	t->running = true;
+	return true;
+}
+
+void gpu_timer_end(struct gpu_timer *t)
+{
+	if (!t->running)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	t->running = false;
+	t->issued++;
+}
+
+bool gpu_timer_result(struct gpu_timer *t, float *us)
+{
+	GLuint query;
+	GLint available = 0;
+	GLuint64 ns;
+
+	if (t->retired == t->issued)
+		return false;
+
+	query = t->queries[t->retired % GPU_TIMER_DEPTH];
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return false;
+
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+	t->retired++;
+	*us = (float)ns * 1e-3f;
+	return true;
+}
+
+void shading_stats_init(struct shading_stats *s)
+{
+	s->have_query = GLEW_ARB_pipeline_statistics_query;
+	if (s->have_query)
+		glGenQueries(SHADING_STATS_DEPTH, s->queries);
+
+	glGenBuffers(SHADING_STATS_DEPTH, s->counters);
+	for (int i = 0; i < SHADING_STATS_DEPTH; i++) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, s->counters[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+		s->fences[i] = 0;
+	}
+	s->issued = 0;
+	s->retired = 0;
+	s->running = false;
+	s->invocations = 0;
+	s->evaluated = 0;
+	s->contributed = 0;
+}
+
+void shading_stats_destroy(struct shading_stats *s)
+{
+	for (int i = 0; i < SHADING_STATS_DEPTH; i++) {
+		if (s->fences[i] != 0)
+			glDeleteSync(s->fences[i]);
+	}
+	glDeleteBuffers(SHADING_STATS_DEPTH, s->counters);
+	if (s->have_query)
+		glDeleteQueries(SHADING_STATS_DEPTH, s->queries);
+}
+
+bool shading_stats_begin(struct shading_stats *s)
+{
+	GLuint slot = s->issued % SHADING_STATS_DEPTH;
+	GLuint zero = 0;
+
+	if (s->issued - s->retired >= SHADING_STATS_DEPTH)
+		return false;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADING_COUNTERS_BINDING, s->counters[slot]);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	if (s->have_query)
+		glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, s->queries[slot]);
+	s->running = true;
+	return true;
+}
+
+void shading_stats_end(struct shading_stats *s)
+{
+	GLuint slot = s->issued % SHADING_STATS_DEPTH;
+
+	if (!s->running)
+		return;
+
+	if (s->have_query)
+		glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+	s->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	s->running = false;
+	s->issued++;
+}
+
+bool shading_stats_poll(struct shading_stats *s)
+{
+	GLuint slot = s->retired % SHADING_STATS_DEPTH;
+	GLuint counts[2];
+	GLenum status;
+
+	if (s->retired == s->issued)
+		return false;
+
+	status = glClientWaitSync(s->fences[slot], 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return false;
+
+	glDeleteSync(s->fences[slot]);
+	s->fences[slot] = 0;
+
+	if (s->have_query)
+		glGetQueryObjectui64v(s->queries[slot], GL_QUERY_RESULT, &(s->invocations));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, s->counters[slot]);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), counts);
+	s->evaluated   = counts[0];
+	s->contributed = counts[1];
+	s->retired++;
+	return true;
+}
+
+void stage_clock_start(struct stage_clock *clk)
+{
+	clk->last = std::chrono::steady_clock::now();
+}
+
+void stage_clock_lap(struct stage_clock *clk, struct frame_stats *stats, enum frame_stage stage)
+{
+	auto now = std::chrono::steady_clock::now();
+	stats->stage_us[stage] = std::chrono::duration<float, std::micro>(now - clk->last).count();
+	clk->last = now;
+}
+
+static void smooth(float *avg, float cur)
+{
+	*avg += (cur - *avg) * SMOOTHING;
+}
+
+void frame_stats_smooth(struct frame_stats *avg, const struct frame_stats *cur)
+{
+	for (int i = 0; i < STAGE_COUNT; i++)
+		smooth(&(avg->stage_us[i]), cur->stage_us[i]);
+
+	smooth(&(avg->frame_us),   cur->frame_us);
+	smooth(&(avg->gpu_us),     cur->gpu_us);
+	smooth(&(avg->hud_gpu_us), cur->hud_gpu_us);
+}
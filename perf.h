@@ -0,0 +1,97 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <GL/glew.h>
+#include <chrono>
+
+// How many frames worth of timer queries may be waiting for the GPU. A query
+// is only read back once its result is available, so this must cover the
+// number of frames the driver is allowed to queue
+#define GPU_TIMER_DEPTH 4
+
+struct gpu_timer {
+	GLuint queries[GPU_TIMER_DEPTH];
+	GLuint issued;  // Number of queries begun so far
+	GLuint retired; // Number of queries whose result has been read
+	GLuint skipped; // Frames not timed because the ring was full
+	bool running;
+};
+
+void gpu_timer_init(struct gpu_timer *t);
+void gpu_timer_destroy(struct gpu_timer *t);
+
+// Returns false (and times nothing) if all queries are still in flight
+bool gpu_timer_begin(struct gpu_timer *t);
+void gpu_timer_end(struct gpu_timer *t);
+
+// Retires the oldest finished query without waiting. Returns true and stores
+// the elapsed GPU time in microseconds if there was one
+bool gpu_timer_result(struct gpu_timer *t, float *us);
+
+// Frames of shading statistics that may be in flight, see shading_stats
+#define SHADING_STATS_DEPTH 4
+
+// Binding of the counter buffer fs.glsl adds to in the debug modes
+#define SHADING_COUNTERS_BINDING 0
+
+// Per frame fragment shader invocations (GL_ARB_pipeline_statistics_query)
+// and how many ball evaluations there were and how many of them survived
+// kill_tail, as counted by fs.glsl. Only meant for the debug heatmap modes,
+// the counters cost an atomic per fragment
+struct shading_stats {
+	GLuint queries[SHADING_STATS_DEPTH];
+	GLuint counters[SHADING_STATS_DEPTH];
+	GLsync fences[SHADING_STATS_DEPTH];
+	GLuint issued;
+	GLuint retired;
+	bool have_query;
+	bool running;
+
+	// Results of the latest retired frame
+	GLuint64 invocations;
+	GLuint evaluated;
+	GLuint contributed;
+};
+
+void shading_stats_init(struct shading_stats *s);
+void shading_stats_destroy(struct shading_stats *s);
+
+// Binds a cleared counter buffer for fs.glsl. Returns false if all slots
+// are still in use by the GPU
+bool shading_stats_begin(struct shading_stats *s);
+void shading_stats_end(struct shading_stats *s);
+
+// Picks up finished frames without waiting, returns true if there was one
+bool shading_stats_poll(struct shading_stats *s);
+
+// Parts of the CPU side of a frame, in the order the main loop runs them
+enum frame_stage {
+	STAGE_WAIT,
+	STAGE_SIMULATE,
+	STAGE_UPLOAD,
+	STAGE_INPUT,
+	STAGE_DRAW,
+	STAGE_SWAP,
+	STAGE_COUNT,
+};
+
+struct frame_stats {
+	float stage_us[STAGE_COUNT];
+	float frame_us;
+	float gpu_us;
+	float hud_gpu_us;
+};
+
+struct stage_clock {
+	std::chrono::steady_clock::time_point last;
+};
+
+void stage_clock_start(struct stage_clock *clk);
+
+// Charges the time since the previous lap to the given stage
+void stage_clock_lap(struct stage_clock *clk, struct frame_stats *stats, enum frame_stage stage);
+
+// Exponential moving average of cur into avg, for display
+void frame_stats_smooth(struct frame_stats *avg, const struct frame_stats *cur);
+
+#endif
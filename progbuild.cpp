@@ -0,0 +1,277 @@
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "progbuild.h"
+#include "progcache.h"
+
+#define LOG_SZ 1024
+
+static bool parallel;
+
+// Only used without GL_KHR_parallel_shader_compile
+static GLFWwindow *worker_window;
+static std::thread worker;
+static std::mutex mtx;
+static std::condition_variable queue_cv;
+static std::condition_variable done_cv;
+static std::deque<struct progbuild *> queue;
+static bool quit;
+
+static bool shader_ok(GLuint shader, const char *fn)
+{
+	GLint success;
+	GLchar log[LOG_SZ];
+
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(shader, LOG_SZ - 1, NULL, log);
+		fprintf(stderr, "Failed to compile shader %s:\n%s\n", fn, log);
+	}
+	return success;
+}
+
+// names is what the log calls the program, e.g. "vs.glsl and fs.glsl"
+static bool program_ok(GLuint prg, const std::string &names)
+{
+	GLint success;
+	GLchar log[LOG_SZ];
+
+	glGetProgramiv(prg, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(prg, LOG_SZ - 1, NULL, log);
+		fprintf(stderr, "Failed to link %s:\n%s\n", names.c_str(), log);
+	}
+	return success;
+}
+
+static std::string stage_names(const struct progbuild *b)
+{
+	std::string names = b->fns[0];
+	for (GLuint i = 1; i < b->num_stages; i++)
+		names += " and " + b->fns[i];
+	return names;
+}
+
+static GLuint compile(const char *src, GLint sz, GLenum type)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &src, &sz);
+	glCompileShader(shader);
+	return shader;
+}
+
+// Issues the compiles and the link without asking how they went
+static void compile_and_link(struct progbuild *b)
+{
+	b->prg = glCreateProgram();
+	glProgramParameteri(b->prg, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	for (GLuint i = 0; i < b->num_stages; i++) {
+		b->shaders[i] = compile(b->srcs[i].data(), b->srcs[i].size(), b->types[i]);
+		glAttachShader(b->prg, b->shaders[i]);
+	}
+	glLinkProgram(b->prg);
+}
+
+// Reports how compile_and_link went, blocking if it is not done yet.
+// Leaves b->prg 0 on failure
+static bool check_and_clean_up(struct progbuild *b)
+{
+	bool ok = true;
+
+	for (GLuint i = 0; i < b->num_stages; i++)
+		ok = ok && shader_ok(b->shaders[i], b->fns[i].c_str());
+	ok = ok && program_ok(b->prg, stage_names(b));
+
+	for (GLuint i = 0; i < b->num_stages; i++) {
+		glDeleteShader(b->shaders[i]);
+		b->shaders[i] = 0;
+	}
+	if (!ok) {
+		glDeleteProgram(b->prg);
+		b->prg = 0;
+	}
+	return ok;
+}
+
+static void build_now(struct progbuild *b)
+{
+	compile_and_link(b);
+	if (check_and_clean_up(b))
+		progcache_store(b->key, b->prg);
+}
+
+GLuint progbuild_link(const char *vs_fn, const char *vs_src, GLint vs_sz,
+                      const char *fs_fn, const char *fs_src, GLint fs_sz)
+{
+	struct progbuild b;
+
+	b.num_stages = 2;
+	b.types[0] = GL_VERTEX_SHADER;
+	b.types[1] = GL_FRAGMENT_SHADER;
+	b.fns[0] = vs_fn;
+	b.fns[1] = fs_fn;
+	b.srcs[0].assign(vs_src, vs_sz);
+	b.srcs[1].assign(fs_src, fs_sz);
+
+	compile_and_link(&b);
+	check_and_clean_up(&b);
+	return b.prg;
+}
+
+static void work(void)
+{
+	glfwMakeContextCurrent(worker_window);
+	for (;;) {
+		struct progbuild *b;
+		{
+			std::unique_lock<std::mutex> lck(mtx);
+			queue_cv.wait(lck, [] { return quit || !queue.empty(); });
+			if (quit)
+				break;
+			b = queue.front();
+			queue.pop_front();
+		}
+
+		build_now(b);
+
+		// Objects changed in one context are only safe to use in another
+		// once the commands that changed them have completed
+		glFinish();
+
+		std::lock_guard<std::mutex> lck(mtx);
+		b->state = b->prg != 0 ? PROGBUILD_READY : PROGBUILD_FAILED;
+		done_cv.notify_all();
+	}
+	glfwMakeContextCurrent(NULL);
+}
+
+void progbuild_init(GLFWwindow *main_window)
+{
+	parallel = GLEW_KHR_parallel_shader_compile;
+	if (parallel) {
+		// Let the driver decide how many threads to use
+		glMaxShaderCompilerThreadsKHR(0xffffffff);
+		return;
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	worker_window = glfwCreateWindow(1, 1, "", NULL, main_window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (worker_window == NULL) {
+		fprintf(stderr, "No shader compiler context, building programs synchronously\n");
+		return;
+	}
+	quit = false;
+	worker = std::thread(work);
+}
+
+void progbuild_destroy(void)
+{
+	if (worker_window == NULL)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lck(mtx);
+		quit = true;
+		queue.clear();
+		queue_cv.notify_all();
+	}
+	worker.join();
+	glfwDestroyWindow(worker_window);
+	worker_window = NULL;
+}
+
+static void start(struct progbuild *b)
+{
+	const char *srcs[PROGBUILD_MAX_STAGES];
+	GLint szs[PROGBUILD_MAX_STAGES];
+
+	for (GLuint i = 0; i < b->num_stages; i++) {
+		srcs[i] = b->srcs[i].data();
+		szs[i]  = b->srcs[i].size();
+		b->shaders[i] = 0;
+	}
+	b->queued = false;
+
+	b->key = progcache_key(srcs, szs, b->num_stages);
+	b->prg = progcache_load(b->key);
+	if (b->prg != 0) {
+		b->state = PROGBUILD_READY;
+		return;
+	}
+
+	if (parallel) {
+		// Nothing here waits for the compiler, progbuild_poll asks
+		// GL_COMPLETION_STATUS_KHR before touching any results
+		compile_and_link(b);
+		b->state = PROGBUILD_PENDING;
+	} else if (worker_window != NULL) {
+		std::lock_guard<std::mutex> lck(mtx);
+		b->state = PROGBUILD_PENDING;
+		b->queued = true;
+		queue.push_back(b);
+		queue_cv.notify_one();
+	} else {
+		build_now(b);
+		b->state = b->prg != 0 ? PROGBUILD_READY : PROGBUILD_FAILED;
+	}
+}
+
+void progbuild_start(struct progbuild *b, const char *vs_fn, const char *vs_src, GLint vs_sz,
+                     const char *fs_fn, const char *fs_src, GLint fs_sz)
+{
+	b->num_stages = 2;
+	b->types[0] = GL_VERTEX_SHADER;
+	b->types[1] = GL_FRAGMENT_SHADER;
+	b->fns[0] = vs_fn;
+	b->fns[1] = fs_fn;
+	b->srcs[0].assign(vs_src, vs_sz);
+	b->srcs[1].assign(fs_src, fs_sz);
+	start(b);
+}
+
+void progbuild_start_compute(struct progbuild *b, const char *cs_fn, const char *cs_src, GLint cs_sz)
+{
+	b->num_stages = 1;
+	b->types[0] = GL_COMPUTE_SHADER;
+	b->fns[0] = cs_fn;
+	b->srcs[0].assign(cs_src, cs_sz);
+	start(b);
+}
+
+// Collects the results of a parallel build, blocks if it is not done yet
+static void finish_parallel(struct progbuild *b)
+{
+	if (check_and_clean_up(b)) {
+		progcache_store(b->key, b->prg);
+		b->state = PROGBUILD_READY;
+	} else {
+		b->state = PROGBUILD_FAILED;
+	}
+}
+
+enum progbuild_state progbuild_poll(struct progbuild *b)
+{
+	GLint done = GL_FALSE;
+
+	if (b->state == PROGBUILD_PENDING && !b->queued) {
+		glGetProgramiv(b->prg, GL_COMPLETION_STATUS_KHR, &done);
+		if (done)
+			finish_parallel(b);
+	}
+	return (enum progbuild_state)b->state.load();
+}
+
+GLuint progbuild_wait(struct progbuild *b)
+{
+	if (b->queued) {
+		std::unique_lock<std::mutex> lck(mtx);
+		done_cv.wait(lck, [b] { return b->state != PROGBUILD_PENDING; });
+	} else if (b->state == PROGBUILD_PENDING) {
+		finish_parallel(b);
+	}
+	return b->state == PROGBUILD_READY ? b->prg : 0;
+}
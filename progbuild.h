@@ -0,0 +1,57 @@
+#ifndef PROGBUILD_H
+#define PROGBUILD_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Builds programs without stalling the render thread. With
+// GL_KHR_parallel_shader_compile the driver compiles on its own threads and
+// progbuild_poll only asks whether it is done. Without it a worker thread
+// with a hidden context sharing objects with the main one does the compiling
+// and linking. If neither is possible, progbuild_start builds synchronously
+
+enum progbuild_state {
+	PROGBUILD_PENDING,
+	PROGBUILD_READY,
+	PROGBUILD_FAILED,
+};
+
+// Vertex and fragment, or just compute
+#define PROGBUILD_MAX_STAGES 2
+
+struct progbuild {
+	GLuint num_stages;
+	GLenum types[PROGBUILD_MAX_STAGES];
+	std::string fns[PROGBUILD_MAX_STAGES];
+	std::string srcs[PROGBUILD_MAX_STAGES];
+	GLuint shaders[PROGBUILD_MAX_STAGES];
+	uint64_t key;
+	GLuint prg;
+	std::atomic<int> state;
+	bool queued; // Handed to the worker thread
+};
+
+// Call with the main context current, before any builds are started
+void progbuild_init(GLFWwindow *main_window);
+void progbuild_destroy(void);
+
+// The sources are copied. Programs in the program cache are ready right away
+void progbuild_start(struct progbuild *b, const char *vs_fn, const char *vs_src, GLint vs_sz,
+                     const char *fs_fn, const char *fs_src, GLint fs_sz);
+void progbuild_start_compute(struct progbuild *b, const char *cs_fn, const char *cs_src, GLint cs_sz);
+
+// Never blocks. Once this returns PROGBUILD_READY, b->prg can be used on the
+// main context and belongs to the caller
+enum progbuild_state progbuild_poll(struct progbuild *b);
+
+// Blocks until the build is done and returns the program, or 0 on failure
+GLuint progbuild_wait(struct progbuild *b);
+
+// Synchronous build on the current context, for things too small to bother
+GLuint progbuild_link(const char *vs_fn, const char *vs_src, GLint vs_sz,
+                      const char *fs_fn, const char *fs_src, GLint fs_sz);
+
+#endif
@@ -0,0 +1,184 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "progcache.h"
+
+#define CACHE_MAGIC   0x42504850u // "PHPB"
+#define CACHE_VERSION 1u
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME  0x100000001b3ull
+
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t length;
+	uint64_t key;
+};
+
+static bool cache_enabled;
+static std::string cache_dir;
+
+static int mkdir_p(const std::string &path)
+{
+	for (size_t i = 1; i <= path.size(); i++) {
+		if (i < path.size() && path[i] != '/')
+			continue;
+		if (mkdir(path.substr(0, i).c_str(), 0755) != 0 && errno != EEXIST)
+			return 1;
+	}
+	return 0;
+}
+
+void progcache_init(bool enabled)
+{
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+
+	cache_enabled = false;
+	if (!enabled)
+		return;
+
+	if (xdg != NULL && xdg[0] == '/')
+		cache_dir = std::string(xdg) + "/ph";
+	else if (home != NULL)
+		cache_dir = std::string(home) + "/.cache/ph";
+	else
+		return;
+
+	if (mkdir_p(cache_dir) != 0) {
+		fprintf(stderr, "Failed to create program cache %s: %s\n",
+		        cache_dir.c_str(), strerror(errno));
+		return;
+	}
+	cache_enabled = true;
+}
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+static uint64_t fnv1a_str(uint64_t h, const GLubyte *s)
+{
+	if (s == NULL)
+		return h;
+	// Include the terminator so "ab" + "c" differs from "a" + "bc"
+	return fnv1a(h, s, strlen((const char *)s) + 1);
+}
+
+uint64_t progcache_key(const char *const *srcs, const GLint *lens, int n)
+{
+	uint64_t h = FNV_OFFSET;
+
+	h = fnv1a_str(h, glGetString(GL_VENDOR));
+	h = fnv1a_str(h, glGetString(GL_RENDERER));
+	h = fnv1a_str(h, glGetString(GL_VERSION));
+	for (int i = 0; i < n; i++) {
+		h = fnv1a(h, srcs[i], lens[i]);
+		h = fnv1a(h, "", 1);
+	}
+	return h;
+}
+
+static std::string cache_path(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+	return cache_dir + name;
+}
+
+GLuint progcache_load(uint64_t key)
+{
+	GLuint prg = 0;
+	GLint success;
+	struct cache_header hdr;
+	std::vector<char> binary;
+	std::string path;
+	FILE *f;
+
+	if (!cache_enabled)
+		goto out;
+
+	path = cache_path(key);
+	f = fopen(path.c_str(), "rb");
+	if (f == NULL)
+		goto out;
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != CACHE_MAGIC ||
+	    hdr.version != CACHE_VERSION || hdr.key != key)
+		goto out_close;
+
+	binary.resize(hdr.length);
+	if (fread(binary.data(), 1, hdr.length, f) != hdr.length)
+		goto out_close;
+
+	prg = glCreateProgram();
+	glProgramBinary(prg, hdr.format, binary.data(), hdr.length);
+	glGetProgramiv(prg, GL_LINK_STATUS, &success);
+	if (!success) {
+		// Typically a driver update, the new binary will replace this one
+		glDeleteProgram(prg);
+		prg = 0;
+	}
+out_close:
+	fclose(f);
+out:
+	return prg;
+}
+
+void progcache_store(uint64_t key, GLuint prg)
+{
+	struct cache_header hdr;
+	std::vector<char> binary;
+	std::string path, tmp;
+	GLint len = 0;
+	GLenum format;
+	FILE *f;
+
+	if (!cache_enabled)
+		return;
+
+	glGetProgramiv(prg, GL_PROGRAM_BINARY_LENGTH, &len);
+	if (len <= 0)
+		return;
+
+	binary.resize(len);
+	glGetProgramBinary(prg, len, &len, &format, binary.data());
+
+	hdr.magic   = CACHE_MAGIC;
+	hdr.version = CACHE_VERSION;
+	hdr.format  = format;
+	hdr.length  = len;
+	hdr.key     = key;
+
+	// Written next to the final name and renamed over it, so concurrent
+	// starts never see a half written binary
+	path = cache_path(key);
+	tmp = path + "." + std::to_string(getpid());
+	f = fopen(tmp.c_str(), "wb");
+	if (f == NULL)
+		return;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 || fwrite(binary.data(), 1, len, f) != (size_t)len) {
+		fclose(f);
+		unlink(tmp.c_str());
+		return;
+	}
+	fclose(f);
+	if (rename(tmp.c_str(), path.c_str()) != 0)
+		unlink(tmp.c_str());
+}
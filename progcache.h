@@ -0,0 +1,23 @@
+#ifndef PROGCACHE_H
+#define PROGCACHE_H
+
+#include <GL/glew.h>
+#include <cstdint>
+
+// On-disk cache of linked program binaries in $XDG_CACHE_HOME/ph (or
+// ~/.cache/ph), keyed by the GL renderer and version and the shader sources.
+// Needs a current context for everything but progcache_init
+
+void progcache_init(bool enabled);
+
+// Hash identifying a program built from srcs on the current driver
+uint64_t progcache_key(const char *const *srcs, const GLint *lens, int n);
+
+// Returns a linked program or 0 if there is nothing cached or the driver
+// does not take the binary any more, in which case just build it again
+GLuint progcache_load(uint64_t key);
+
+// prg should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+void progcache_store(uint64_t key, GLuint prg);
+
+#endif
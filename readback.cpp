@@ -0,0 +1,91 @@
+#include <cstdio>
+
+#include "readback.h"
+
+// Checked again after this long in case the context got lost or the like
+#define WAIT_TIMEOUT_NS 100000000ull
+
+int readback_init(struct readback *rb, int width, int height)
+{
+	int rv = 0;
+	size_t sz = (size_t)width * height * 4;
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	rb->width = width;
+	rb->height = height;
+	rb->issued = 0;
+	rb->retired = 0;
+
+	glGenBuffers(READBACK_DEPTH, rb->pbos);
+	for (int i = 0; i < READBACK_DEPTH; i++) {
+		rb->fences[i] = 0;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[i]);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, sz, NULL, flags | GL_CLIENT_STORAGE_BIT);
+		rb->mapped[i] = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sz, flags);
+		if (rb->mapped[i] == NULL) {
+			fprintf(stderr, "Failed to map readback buffer\n");
+			rv = 1;
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return rv;
+}
+
+void readback_destroy(struct readback *rb)
+{
+	for (int i = 0; i < READBACK_DEPTH; i++) {
+		if (rb->fences[i] != 0)
+			glDeleteSync(rb->fences[i]);
+		if (rb->mapped[i] != NULL) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[i]);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glDeleteBuffers(READBACK_DEPTH, rb->pbos);
+}
+
+bool readback_start(struct readback *rb, GLuint fbo)
+{
+	GLuint slot = rb->issued % READBACK_DEPTH;
+
+	if (rb->issued - rb->retired == READBACK_DEPTH)
+		return false;
+
+	// Into the buffer, so glReadPixels returns without waiting for the GPU
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[slot]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, rb->width, rb->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	rb->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	rb->issued++;
+	return true;
+}
+
+const unsigned char *readback_oldest(struct readback *rb, bool wait)
+{
+	GLuint slot = rb->retired % READBACK_DEPTH;
+	GLenum status;
+
+	if (rb->retired == rb->issued)
+		return NULL;
+
+	if (rb->fences[slot] != 0) {
+		do {
+			status = glClientWaitSync(rb->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT,
+			                          wait ? WAIT_TIMEOUT_NS : 0);
+		} while (wait && status == GL_TIMEOUT_EXPIRED);
+		if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+			return NULL;
+		glDeleteSync(rb->fences[slot]);
+		rb->fences[slot] = 0;
+	}
+	return rb->mapped[slot];
+}
+
+void readback_release(struct readback *rb)
+{
+	rb->retired++;
+}
@@ -0,0 +1,34 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <GL/glew.h>
+
+// Frames read back into pixel buffers ahead of being used. Deeper than
+// MAX_FRAMES_IN_FLIGHT, so the oldest one is normally done by the time it
+// is needed and mapping it never waits for the GPU
+#define READBACK_DEPTH 4
+
+// Ring of persistently mapped pixel pack buffers, each guarded by a fence.
+// Frames come out RGBA, bottom row first, in the order they went in
+struct readback {
+	int width, height;
+	GLuint pbos[READBACK_DEPTH];
+	const unsigned char *mapped[READBACK_DEPTH];
+	GLsync fences[READBACK_DEPTH];
+	unsigned issued;
+	unsigned retired;
+};
+
+int readback_init(struct readback *rb, int width, int height);
+void readback_destroy(struct readback *rb);
+
+// Starts reading the lower left width x height pixels of fbo. Returns false,
+// reading nothing, if the ring is full
+bool readback_start(struct readback *rb, GLuint fbo);
+
+// The oldest frame, or NULL if there is none. Without wait, also NULL while
+// the GPU is still on it. Valid until readback_release
+const unsigned char *readback_oldest(struct readback *rb, bool wait);
+void readback_release(struct readback *rb);
+
+#endif
@@ -0,0 +1,188 @@
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include "record.h"
+
+int recorder_init(struct recorder *rec, const struct record_config *config)
+{
+	int rv = 0;
+	size_t pixels = (size_t)config->width * config->height;
+	GLenum status;
+
+	rec->config = *config;
+	rec->frames_captured = 0;
+	rec->frames_written = 0;
+	rec->fbo = 0;
+	rec->rbo = 0;
+
+	if (strcmp(config->path, "-") == 0) {
+		rec->out = stdout;
+	} else {
+		rec->out = fopen(config->path, "wb");
+		if (rec->out == NULL) {
+			fprintf(stderr, "Failed to open %s: %s\n", config->path, strerror(errno));
+			rv = 1;
+			goto out;
+		}
+	}
+
+	if (config->format == RECORD_Y4M) {
+		// Chroma planes round up for odd sizes
+		size_t chroma = (size_t)((config->width + 1) / 2) * ((config->height + 1) / 2);
+		rec->frame.resize(pixels + 2 * chroma);
+		fprintf(rec->out, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n",
+		        config->width, config->height, config->fps);
+	} else {
+		rec->frame.resize(pixels * 3);
+	}
+
+	if (readback_init(&(rec->readback), config->width, config->height) != 0) {
+		rv = 1;
+		goto out;
+	}
+
+	glGenRenderbuffers(1, &(rec->rbo));
+	glBindRenderbuffer(GL_RENDERBUFFER, rec->rbo);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, config->width, config->height);
+
+	glGenFramebuffers(1, &(rec->fbo));
+	glBindFramebuffer(GL_FRAMEBUFFER, rec->fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rec->rbo);
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Can not render at %dx%d (framebuffer status 0x%x)\n",
+		        config->width, config->height, status);
+		rv = 1;
+	}
+out:
+	return rv;
+}
+
+void recorder_destroy(struct recorder *rec)
+{
+	readback_destroy(&(rec->readback));
+	glDeleteFramebuffers(1, &(rec->fbo));
+	glDeleteRenderbuffers(1, &(rec->rbo));
+	if (rec->out == stdout)
+		fflush(stdout);
+	else if (rec->out != NULL)
+		fclose(rec->out);
+	rec->out = NULL;
+}
+
+static const unsigned char *pixel(const struct recorder *rec, const unsigned char *rgba,
+                                  int x, int y)
+{
+	int w = rec->config.width, h = rec->config.height;
+
+	// GL rows go bottom up, video rows top down
+	return rgba + 4 * ((size_t)(h - 1 - y) * w + x);
+}
+
+static void to_rgb24(struct recorder *rec, const unsigned char *rgba)
+{
+	unsigned char *dst = rec->frame.data();
+
+	for (int y = 0; y < rec->config.height; y++) {
+		for (int x = 0; x < rec->config.width; x++) {
+			const unsigned char *p = pixel(rec, rgba, x, y);
+			*dst++ = p[0];
+			*dst++ = p[1];
+			*dst++ = p[2];
+		}
+	}
+}
+
+// BT.601 in 8 bit fixed point, luma 16..235 and chroma 16..240
+static unsigned char luma(int r, int g, int b)
+{
+	return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static void to_yuv420(struct recorder *rec, const unsigned char *rgba)
+{
+	int w = rec->config.width, h = rec->config.height;
+	int cw = (w + 1) / 2, ch = (h + 1) / 2;
+	unsigned char *y_plane = rec->frame.data();
+	unsigned char *u_plane = y_plane + (size_t)w * h;
+	unsigned char *v_plane = u_plane + (size_t)cw * ch;
+
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			const unsigned char *p = pixel(rec, rgba, x, y);
+			y_plane[(size_t)y * w + x] = luma(p[0], p[1], p[2]);
+		}
+	}
+
+	// Chroma from the average of each 2x2 block, edges repeat
+	for (int y = 0; y < ch; y++) {
+		for (int x = 0; x < cw; x++) {
+			int r = 0, g = 0, b = 0;
+
+			for (int i = 0; i < 4; i++) {
+				int px = std::min(2 * x + (i & 1), w - 1);
+				int py = std::min(2 * y + (i >> 1), h - 1);
+				const unsigned char *p = pixel(rec, rgba, px, py);
+				r += p[0];
+				g += p[1];
+				b += p[2];
+			}
+			r = (r + 2) / 4;
+			g = (g + 2) / 4;
+			b = (b + 2) / 4;
+			u_plane[(size_t)y * cw + x] = ((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+			v_plane[(size_t)y * cw + x] = ((112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+		}
+	}
+}
+
+// Writes out the oldest frame in the ring
+static int write_frame(struct recorder *rec)
+{
+	const unsigned char *rgba = readback_oldest(&(rec->readback), true);
+
+	// Only if waiting for the GPU failed, the frame is lost
+	if (rgba == NULL) {
+		fprintf(stderr, "Failed to read back frame %u\n", rec->frames_written);
+		return 1;
+	}
+	if (rec->config.format == RECORD_Y4M) {
+		to_yuv420(rec, rgba);
+		fputs("FRAME\n", rec->out);
+	} else {
+		to_rgb24(rec, rgba);
+	}
+	readback_release(&(rec->readback));
+	if (fwrite(rec->frame.data(), 1, rec->frame.size(), rec->out) != rec->frame.size()) {
+		fprintf(stderr, "Failed to write frame %u: %s\n", rec->frames_written, strerror(errno));
+		return 1;
+	}
+	rec->frames_written++;
+	return 0;
+}
+
+int recorder_capture(struct recorder *rec)
+{
+	// A slot is free again once its frame is written out
+	if (rec->frames_captured - rec->frames_written == READBACK_DEPTH &&
+	    write_frame(rec) != 0)
+		return 1;
+
+	readback_start(&(rec->readback), rec->fbo);
+	rec->frames_captured++;
+
+	if (rec->frames_captured < rec->config.frames)
+		return 0;
+	while (rec->frames_written < rec->frames_captured) {
+		if (write_frame(rec) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+bool recorder_done(const struct recorder *rec)
+{
+	return rec->frames_written >= rec->config.frames;
+}
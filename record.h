@@ -0,0 +1,51 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <GL/glew.h>
+#include <cstdio>
+#include <vector>
+
+#include "readback.h"
+
+#define RECORD_DEFAULT_FPS 60
+
+enum record_format {
+	RECORD_Y4M,   // YUV4MPEG2, 4:2:0 BT.601 limited range
+	RECORD_RGB24, // Headerless packed RGB, top row first
+};
+
+struct record_config {
+	unsigned frames;
+	int width, height;
+	unsigned fps;
+	enum record_format format;
+	const char *path; // "-" for stdout
+};
+
+// Offline rendering into a framebuffer of its own, written out frame by frame
+// so that the output can be piped into an encoder
+struct recorder {
+	struct record_config config;
+	FILE *out;
+	GLuint fbo;
+	GLuint rbo;
+	unsigned frames_captured;
+	unsigned frames_written;
+	struct readback readback;
+
+	std::vector<unsigned char> frame; // In the output format
+};
+
+// Opens the output and writes the stream header
+int recorder_init(struct recorder *rec, const struct record_config *config);
+void recorder_destroy(struct recorder *rec);
+
+// Starts reading back what has been drawn to rec->fbo and writes out the
+// frame captured READBACK_DEPTH frames ago, or all of them after the last
+// frame. Returns nonzero on errors
+int recorder_capture(struct recorder *rec);
+
+// True once every frame has been captured and written
+bool recorder_done(const struct recorder *rec);
+
+#endif
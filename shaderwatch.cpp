@@ -0,0 +1,55 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "shaderwatch.h"
+
+#define EVENT_BUF_SZ 4096
+
+int shader_watch_init(struct shader_watch *w, const char *dir)
+{
+	w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (w->fd < 0) {
+		fprintf(stderr, "Failed to create inotify instance: %s\n", strerror(errno));
+		return 1;
+	}
+	if (inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		fprintf(stderr, "Failed to watch %s: %s\n", dir, strerror(errno));
+		close(w->fd);
+		w->fd = -1;
+		return 1;
+	}
+	return 0;
+}
+
+void shader_watch_destroy(struct shader_watch *w)
+{
+	if (w->fd >= 0)
+		close(w->fd);
+	w->fd = -1;
+}
+
+static bool is_shader(const char *name)
+{
+	size_t len = strlen(name);
+	return len > 5 && strcmp(name + len - 5, ".glsl") == 0;
+}
+
+bool shader_watch_poll(struct shader_watch *w)
+{
+	alignas(struct inotify_event) char buf[EVENT_BUF_SZ];
+	bool changed = false;
+	ssize_t n;
+
+	while ((n = read(w->fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + n; ) {
+			const struct inotify_event *ev = (const struct inotify_event *)p;
+			if (ev->len > 0 && is_shader(ev->name))
+				changed = true;
+			p += sizeof(*ev) + ev->len;
+		}
+	}
+	return changed;
+}
@@ -0,0 +1,17 @@
+#ifndef SHADERWATCH_H
+#define SHADERWATCH_H
+
+// Notices when shader sources in a directory change. The directory is
+// watched rather than the files, since editors tend to save by writing a new
+// file and renaming it over the old one, and so new files show up too
+struct shader_watch {
+	int fd;
+};
+
+int shader_watch_init(struct shader_watch *w, const char *dir);
+void shader_watch_destroy(struct shader_watch *w);
+
+// Never blocks. Returns true if any .glsl file was written since the last call
+bool shader_watch_poll(struct shader_watch *w);
+
+#endif
@@ -0,0 +1,398 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+
+#include "shard.h"
+
+#define MANIFEST_VERSION 2
+#define LINE_SZ 4096
+
+// Workers failing in a row before the coordinator gives up
+#define MAX_FAILURES 3
+
+// How often the coordinator looks for shards finished or abandoned elsewhere
+#define POLL_S 5
+
+unsigned shard_count(const struct shard_job *job)
+{
+	return (job->record.frames + job->shard_frames - 1) / job->shard_frames;
+}
+
+static std::string manifest_path(const char *dir)
+{
+	return std::string(dir) + "/manifest";
+}
+
+static std::string shard_path(const char *dir, unsigned index, const char *ext)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "/shard-%05u.%s", index, ext);
+	return dir + std::string(name);
+}
+
+std::string shard_snapshot_path(const char *dir, unsigned step)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "/snapshot-%08u", step);
+	return dir + std::string(name);
+}
+
+static bool exists(const std::string &path)
+{
+	return access(path.c_str(), F_OK) == 0;
+}
+
+int shard_job_read(const char *dir, struct shard_job *job)
+{
+	int rv = 0;
+	std::string path = manifest_path(dir);
+	char format[16], output[LINE_SZ], shader_dir[LINE_SZ];
+	unsigned version;
+	int compute, edge_aa, half, dynamic_resolution;
+	FILE *f = fopen(path.c_str(), "r");
+
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", path.c_str(), strerror(errno));
+		rv = 1;
+		goto out;
+	}
+
+	if (fscanf(f, "ph-job %u\n", &version) != 1 || version != MANIFEST_VERSION ||
+	    fscanf(f, "seed %u\n", &(job->seed)) != 1 ||
+	    fscanf(f, "frames %u\n", &(job->record.frames)) != 1 ||
+	    fscanf(f, "shard-frames %u\n", &(job->shard_frames)) != 1 ||
+	    fscanf(f, "size %dx%d\n", &(job->record.width), &(job->record.height)) != 2 ||
+	    fscanf(f, "fps %u\n", &(job->record.fps)) != 1 ||
+	    fscanf(f, "format %15s\n", format) != 1 ||
+	    fscanf(f, "compute %d\n", &compute) != 1 ||
+	    fscanf(f, "edge-aa %d\n", &edge_aa) != 1 ||
+	    fscanf(f, "half %d\n", &half) != 1 ||
+	    fscanf(f, "dynamic-resolution %d\n", &dynamic_resolution) != 1 ||
+	    fgets(shader_dir, sizeof(shader_dir), f) == NULL ||
+	    strncmp(shader_dir, "shader-dir", 10) != 0 ||
+	    fgets(output, sizeof(output), f) == NULL || strncmp(output, "output ", 7) != 0 ||
+	    job->shard_frames == 0 || job->record.fps == 0) {
+		fprintf(stderr, "Bad manifest %s\n", path.c_str());
+		rv = 1;
+		goto out_close;
+	}
+	job->record.format = strcmp(format, "rgb24") == 0 ? RECORD_RGB24 : RECORD_Y4M;
+	job->output.assign(output + 7, strcspn(output + 7, "\n"));
+	job->record.path = job->output.c_str();
+	job->compute = compute != 0;
+	job->edge_aa = edge_aa != 0;
+	job->half = half != 0;
+	job->dynamic_resolution = dynamic_resolution != 0;
+	// "shader-dir" alone if there is none
+	job->shader_dir.clear();
+	if (shader_dir[10] == ' ')
+		job->shader_dir.assign(shader_dir + 11, strcspn(shader_dir + 11, "\n"));
+out_close:
+	fclose(f);
+out:
+	return rv;
+}
+
+int shard_job_create(const char *dir, struct shard_job *job)
+{
+	std::string path = manifest_path(dir);
+	std::string tmp = path + "." + std::to_string(getpid());
+	FILE *f;
+
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Failed to create %s: %s\n", dir, strerror(errno));
+		return 1;
+	}
+	if (exists(path)) {
+		fprintf(stderr, "Resuming the job in %s\n", dir);
+		return shard_job_read(dir, job);
+	}
+
+	f = fopen(tmp.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "Failed to create %s: %s\n", tmp.c_str(), strerror(errno));
+		return 1;
+	}
+	fprintf(f, "ph-job %u\n", MANIFEST_VERSION);
+	fprintf(f, "seed %u\n", job->seed);
+	fprintf(f, "frames %u\n", job->record.frames);
+	fprintf(f, "shard-frames %u\n", job->shard_frames);
+	fprintf(f, "size %dx%d\n", job->record.width, job->record.height);
+	fprintf(f, "fps %u\n", job->record.fps);
+	fprintf(f, "format %s\n", job->record.format == RECORD_RGB24 ? "rgb24" : "y4m");
+	fprintf(f, "compute %d\n", job->compute ? 1 : 0);
+	fprintf(f, "edge-aa %d\n", job->edge_aa ? 1 : 0);
+	fprintf(f, "half %d\n", job->half ? 1 : 0);
+	fprintf(f, "dynamic-resolution %d\n", job->dynamic_resolution ? 1 : 0);
+	if (job->shader_dir.empty())
+		fprintf(f, "shader-dir\n");
+	else
+		fprintf(f, "shader-dir %s\n", job->shader_dir.c_str());
+	fprintf(f, "output %s\n", job->output.c_str());
+	if (fclose(f) != 0) {
+		unlink(tmp.c_str());
+		return 1;
+	}
+
+	// Another coordinator may have won the race, then its manifest counts
+	if (link(tmp.c_str(), path.c_str()) != 0) {
+		unlink(tmp.c_str());
+		if (errno != EEXIST)
+			return 1;
+		return shard_job_read(dir, job);
+	}
+	unlink(tmp.c_str());
+	return 0;
+}
+
+static int try_claim(const std::string &path)
+{
+	char host[256] = "";
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+
+	if (fd < 0)
+		return 1;
+
+	// Only for people looking at the directory
+	gethostname(host, sizeof(host) - 1);
+	dprintf(fd, "%s %d\n", host, (int)getpid());
+	close(fd);
+	return 0;
+}
+
+// Claims of dead workers are renamed away first. Only one of the workers
+// noticing it at the same time gets to rename it, so only that one steals
+static bool steal_stale(const std::string &path)
+{
+	struct stat st;
+	std::string stale = path + ".stale." + std::to_string(getpid());
+
+	if (stat(path.c_str(), &st) != 0 || time(NULL) - st.st_mtime < SHARD_CLAIM_TIMEOUT_S)
+		return false;
+	if (rename(path.c_str(), stale.c_str()) != 0)
+		return false;
+	unlink(stale.c_str());
+	fprintf(stderr, "Taking over %s\n", path.c_str());
+	return true;
+}
+
+int shard_claim_next(const char *dir, const struct shard_job *job, struct shard_claim *claim)
+{
+	unsigned count = shard_count(job);
+
+	for (unsigned i = 0; i < count; i++) {
+		std::string out_path = shard_path(dir, i, "out");
+		std::string claim_path = shard_path(dir, i, "claim");
+
+		if (exists(out_path))
+			continue;
+		if (try_claim(claim_path) != 0) {
+			if (errno != EEXIST) {
+				fprintf(stderr, "Failed to claim %s: %s\n", claim_path.c_str(), strerror(errno));
+				return 1;
+			}
+			if (!steal_stale(claim_path) || try_claim(claim_path) != 0)
+				continue;
+		}
+
+		// Finished between the check and the claim
+		if (exists(out_path)) {
+			unlink(claim_path.c_str());
+			continue;
+		}
+
+		claim->index = i;
+		claim->first = i * job->shard_frames;
+		claim->frames = std::min(job->shard_frames, job->record.frames - claim->first);
+		claim->claim_path = claim_path;
+		claim->part_path = shard_path(dir, i, "part");
+		claim->out_path = out_path;
+		claim->touched = time(NULL);
+		return 0;
+	}
+	return SHARD_NONE_LEFT;
+}
+
+void shard_touch(struct shard_claim *claim)
+{
+	time_t now = time(NULL);
+
+	if (now == claim->touched)
+		return;
+	utimensat(AT_FDCWD, claim->claim_path.c_str(), NULL, 0);
+	claim->touched = now;
+}
+
+int shard_finish(struct shard_claim *claim)
+{
+	int rv = 0;
+
+	if (rename(claim->part_path.c_str(), claim->out_path.c_str()) != 0) {
+		fprintf(stderr, "Failed to finish %s: %s\n", claim->out_path.c_str(), strerror(errno));
+		rv = 1;
+	}
+	unlink(claim->claim_path.c_str());
+	return rv;
+}
+
+void shard_abandon(struct shard_claim *claim)
+{
+	unlink(claim->part_path.c_str());
+	unlink(claim->claim_path.c_str());
+}
+
+unsigned shard_nearest_snapshot(const char *dir, unsigned step)
+{
+	unsigned best = 0, s;
+	struct dirent *e;
+	DIR *d = opendir(dir);
+
+	if (d == NULL)
+		return 0;
+	while ((e = readdir(d)) != NULL) {
+		if (sscanf(e->d_name, "snapshot-%8u", &s) == 1 && strchr(e->d_name, '.') == NULL &&
+		    s <= step && s > best)
+			best = s;
+	}
+	closedir(d);
+	return best;
+}
+
+static unsigned count_done(const char *dir, const struct shard_job *job)
+{
+	unsigned done = 0;
+
+	for (unsigned i = 0; i < shard_count(job); i++)
+		done += exists(shard_path(dir, i, "out"));
+	return done;
+}
+
+// A Y4M stream starts with one header line, which only the first shard keeps
+static int append_shard(FILE *out, const std::string &path, bool keep_header, bool y4m)
+{
+	int rv = 0;
+	char buf[65536];
+	size_t n;
+	int c;
+	FILE *f = fopen(path.c_str(), "rb");
+
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", path.c_str(), strerror(errno));
+		return 1;
+	}
+	if (y4m && !keep_header) {
+		while ((c = fgetc(f)) != EOF && c != '\n')
+			;
+	}
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		if (fwrite(buf, 1, n, out) != n) {
+			rv = 1;
+			break;
+		}
+	}
+	if (ferror(f))
+		rv = 1;
+	fclose(f);
+	return rv;
+}
+
+static int join_shards(const char *dir, const struct shard_job *job)
+{
+	int rv = 0;
+	bool to_stdout = job->output == "-";
+	FILE *out = to_stdout ? stdout : fopen(job->output.c_str(), "wb");
+
+	if (out == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", job->output.c_str(), strerror(errno));
+		return 1;
+	}
+	for (unsigned i = 0; i < shard_count(job) && rv == 0; i++)
+		rv = append_shard(out, shard_path(dir, i, "out"), i == 0,
+		                  job->record.format == RECORD_Y4M);
+
+	if ((to_stdout ? fflush(out) : fclose(out)) != 0)
+		rv = 1;
+	if (rv != 0)
+		fprintf(stderr, "Failed to write %s\n", job->output.c_str());
+	return rv;
+}
+
+static pid_t spawn_worker(const char *self, const char *dir)
+{
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		// The output may be stdout, which is only for the joined video
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+		execl(self, self, "--worker", dir, (char *)NULL);
+		fprintf(stderr, "Failed to run %s: %s\n", self, strerror(errno));
+		_exit(1);
+	}
+	if (pid < 0)
+		fprintf(stderr, "Failed to start a worker: %s\n", strerror(errno));
+	return pid;
+}
+
+int shard_coordinate(const char *dir, const char *self, unsigned workers)
+{
+	struct shard_job job;
+	unsigned running = 0, failures = 0, count;
+	bool spawning = workers > 0;
+	int status;
+	pid_t pid;
+
+	if (shard_job_read(dir, &job) != 0)
+		return 1;
+	count = shard_count(&job);
+	fprintf(stderr, "%u of %u shards done\n", count_done(dir, &job), count);
+
+	for (;;) {
+		while (spawning && running < workers) {
+			if (spawn_worker(self, dir) < 0) {
+				spawning = false;
+				break;
+			}
+			running++;
+		}
+
+		if (running > 0) {
+			pid = wait(&status);
+			if (pid < 0)
+				return 1;
+			running--;
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+				failures = 0;
+				fprintf(stderr, "%u of %u shards done\n", count_done(dir, &job), count);
+			} else if (WIFEXITED(status) && WEXITSTATUS(status) == SHARD_NONE_LEFT) {
+				spawning = false;
+			} else if (++failures >= MAX_FAILURES) {
+				fprintf(stderr, "Workers keep failing, giving up\n");
+				workers = 0;
+				spawning = false;
+			}
+			continue;
+		}
+
+		if (count_done(dir, &job) == count)
+			break;
+		if (failures >= MAX_FAILURES)
+			return 1;
+
+		// The rest are being rendered elsewhere. If those workers die,
+		// their claims go stale and local workers take over
+		sleep(POLL_S);
+		spawning = workers > 0;
+	}
+	return join_shards(dir, &job);
+}
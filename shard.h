@@ -0,0 +1,86 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <string>
+
+#include "record.h"
+
+#define SHARD_DEFAULT_FRAMES 300
+
+// A claim whose file has not been touched for this long belongs to a worker
+// that died, and is up for grabs again
+#define SHARD_CLAIM_TIMEOUT_S 60
+
+// Exit status of a worker that found nothing left to claim
+#define SHARD_NONE_LEFT 3
+
+// An offline render split into shards of consecutive frames. Everything
+// lives in one directory, which may be shared between machines:
+//
+//   manifest           the job, written once by the coordinator
+//   shard-NNNNN.claim  taken with O_EXCL by the worker rendering the shard,
+//                      touched as it goes
+//   shard-NNNNN.part   the shard being rendered
+//   shard-NNNNN.out    a finished shard, renamed from .part
+//   snapshot-NNNNNNNN  simulation state after that many steps
+//
+// Nothing is ever rewritten in place, so a coordinator started again on the
+// same directory picks up where the last one stopped
+struct shard_job {
+	struct record_config record; // frames and path are of the whole job
+	unsigned seed;
+	unsigned shard_frames;
+	std::string output; // record.path points here
+
+	// Options of the coordinator that change the frames. Workers render
+	// with these instead of their own. An empty shader_dir is the shaders
+	// built into the binary
+	bool compute;
+	bool edge_aa;
+	bool half;
+	bool dynamic_resolution;
+	std::string shader_dir;
+};
+
+unsigned shard_count(const struct shard_job *job);
+
+// Writes the manifest unless there is one, in which case job is replaced by
+// what is in it
+int shard_job_create(const char *dir, struct shard_job *job);
+int shard_job_read(const char *dir, struct shard_job *job);
+
+struct shard_claim {
+	unsigned index;
+	unsigned first;  // Frame, counting from 0
+	unsigned frames;
+	std::string claim_path;
+	std::string part_path;
+	std::string out_path;
+	time_t touched;
+};
+
+// Returns 0 with the first unfinished and unclaimed shard claimed,
+// SHARD_NONE_LEFT if there is none, or 1 on errors
+int shard_claim_next(const char *dir, const struct shard_job *job, struct shard_claim *claim);
+
+// Keeps the claim fresh, cheap enough to call every frame
+void shard_touch(struct shard_claim *claim);
+
+// Publishes the finished shard and drops the claim
+int shard_finish(struct shard_claim *claim);
+
+// Gives the shard back after a failure
+void shard_abandon(struct shard_claim *claim);
+
+std::string shard_snapshot_path(const char *dir, unsigned step);
+
+// The latest snapshot at or before step, 0 if there is none (the seed is the
+// snapshot of step 0)
+unsigned shard_nearest_snapshot(const char *dir, unsigned step);
+
+// Runs workers as "self --worker dir" until every shard is done, at most
+// workers of them at a time, then joins the shards into job->output. With
+// no local workers it waits for workers on other machines
+int shard_coordinate(const char *dir, const char *self, unsigned workers);
+
+#endif
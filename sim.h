@@ -0,0 +1,47 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <random>
+#include <vector>
+
+struct vec2 {
+	float x, y;
+	vec2() : x(0.0f), y(0.0f) {}
+	vec2(float x_, float y_) : x(x_), y(y_) {}
+};
+
+struct vec3 {
+	float x, y, z;
+	vec3() : x(0.0f), y(0.0f), z(0.0f) {}
+	vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+};
+
+struct vec4 {
+	float x, y, z, w;
+	vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	vec4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+};
+
+struct rwp_vs {
+	float rot_v, wrp_v, plp_v;
+	rwp_vs() : rot_v(0.0f), wrp_v(0.0f), plp_v(0.0f) {}
+	rwp_vs(float rot_v_, float wrp_v_, float plp_v_)
+		: rot_v(rot_v_)
+		, wrp_v(wrp_v_)
+		, plp_v(plp_v_)
+	{}
+};
+
+// Everything that carries over from one simulation step to the next
+struct sim_state {
+	float &time;
+	std::minstd_rand &rndgen;
+	std::vector<struct vec3> &ball_pos_rad;
+	std::vector<struct vec3> &ball_color;
+	std::vector<struct vec2> &ball_velocity;
+	std::vector<struct vec4> &ball_params;
+	std::vector<float> &ball_hue_velocity;
+	std::vector<struct rwp_vs> &ball_rwp_velocity;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sstream>
+
+#include "snapshot.h"
+
+int save_snapshot(const std::string &path, const struct sim_state *s)
+{
+	std::ostringstream gen;
+	std::string tmp = path + "." + std::to_string(getpid());
+	FILE *f = fopen(tmp.c_str(), "w");
+
+	if (f == NULL)
+		return 1;
+
+	gen << s->rndgen;
+	fprintf(f, "ph-snapshot 1\n%a %s %zu\n", s->time, gen.str().c_str(), s->ball_pos_rad.size());
+	for (size_t i = 0; i < s->ball_pos_rad.size(); i++) {
+		const struct vec3 &p = s->ball_pos_rad[i], &c = s->ball_color[i];
+		const struct vec2 &v = s->ball_velocity[i];
+		const struct vec4 &bp = s->ball_params[i];
+		const struct rwp_vs &rwp = s->ball_rwp_velocity[i];
+
+		fprintf(f, "%a %a %a  %a %a %a  %a %a  %a %a %a %a  %a  %a %a %a\n",
+		        p.x, p.y, p.z, c.x, c.y, c.z, v.x, v.y, bp.x, bp.y, bp.z, bp.w,
+		        s->ball_hue_velocity[i], rwp.rot_v, rwp.wrp_v, rwp.plp_v);
+	}
+	if (fclose(f) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+		unlink(tmp.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+int load_snapshot(const std::string &path, struct sim_state *s)
+{
+	int rv = 0;
+	char gen[32];
+	size_t n;
+	FILE *f = fopen(path.c_str(), "r");
+
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", path.c_str(), strerror(errno));
+		return 1;
+	}
+
+	if (fscanf(f, "ph-snapshot 1\n%a %31s %zu\n", &(s->time), gen, &n) != 3 ||
+	    n != s->ball_pos_rad.size()) {
+		rv = 1;
+		goto out;
+	}
+	std::istringstream(gen) >> s->rndgen;
+	for (size_t i = 0; i < n && rv == 0; i++) {
+		struct vec3 &p = s->ball_pos_rad[i], &c = s->ball_color[i];
+		struct vec2 &v = s->ball_velocity[i];
+		struct vec4 &bp = s->ball_params[i];
+		struct rwp_vs &rwp = s->ball_rwp_velocity[i];
+
+		if (fscanf(f, "%a %a %a %a %a %a %a %a %a %a %a %a %a %a %a %a",
+		           &p.x, &p.y, &p.z, &c.x, &c.y, &c.z, &v.x, &v.y, &bp.x, &bp.y, &bp.z, &bp.w,
+		           &(s->ball_hue_velocity[i]), &rwp.rot_v, &rwp.wrp_v, &rwp.plp_v) != 16)
+			rv = 1;
+	}
+out:
+	if (rv != 0)
+		fprintf(stderr, "Bad snapshot %s\n", path.c_str());
+	fclose(f);
+	return rv;
+}
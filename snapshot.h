@@ -0,0 +1,16 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+
+#include "sim.h"
+
+// Simulation state as text with the floats in hex, so it comes back bit
+// exact. Written next to the final name and renamed over it, like the
+// program cache
+int save_snapshot(const std::string &path, const struct sim_state *s);
+
+// s has to have as many balls as the snapshot. Returns nonzero on errors
+int load_snapshot(const std::string &path, struct sim_state *s);
+
+#endif
@@ -0,0 +1,188 @@
+#include <GL/glew.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <zlib.h>
+
+#include "still.h"
+
+// Compressed bytes collected before they go out as an IDAT chunk
+#define IDAT_SZ 65536
+
+struct png_writer {
+	FILE *f;
+	z_stream z;
+	std::vector<unsigned char> idat;
+	std::vector<unsigned char> line; // Filter type and filtered row
+};
+
+static void put_be32(unsigned char *p, uLong v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static int write_chunk(struct png_writer *w, const char *type, const unsigned char *data, size_t sz)
+{
+	unsigned char len[4], crc[4];
+	uLong c = crc32(0, (const Bytef *)type, 4);
+
+	if (sz > 0)
+		c = crc32(c, data, sz);
+	put_be32(len, sz);
+	put_be32(crc, c);
+
+	if (fwrite(len, 1, 4, w->f) != 4 || fwrite(type, 1, 4, w->f) != 4 ||
+	    (sz > 0 && fwrite(data, 1, sz, w->f) != sz) || fwrite(crc, 1, 4, w->f) != 4)
+		return 1;
+	return 0;
+}
+
+static int png_begin(struct png_writer *w, const char *path, int width, int height)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	unsigned char ihdr[13];
+
+	w->f = fopen(path, "wb");
+	if (w->f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	memset(&(w->z), 0, sizeof(w->z));
+	if (deflateInit(&(w->z), Z_DEFAULT_COMPRESSION) != Z_OK) {
+		fclose(w->f);
+		return 1;
+	}
+	w->idat.resize(IDAT_SZ);
+	w->z.next_out = w->idat.data();
+	w->z.avail_out = IDAT_SZ;
+	w->line.resize(1 + (size_t)width * 3);
+
+	// 8 bit RGB, not interlaced
+	put_be32(ihdr, width);
+	put_be32(ihdr + 4, height);
+	ihdr[8] = 8;
+	ihdr[9] = 2;
+	ihdr[10] = 0;
+	ihdr[11] = 0;
+	ihdr[12] = 0;
+
+	if (fwrite(signature, 1, sizeof(signature), w->f) != sizeof(signature) ||
+	    write_chunk(w, "IHDR", ihdr, sizeof(ihdr)) != 0) {
+		deflateEnd(&(w->z));
+		fclose(w->f);
+		return 1;
+	}
+	return 0;
+}
+
+static int png_deflate(struct png_writer *w, int flush)
+{
+	int status;
+
+	do {
+		status = deflate(&(w->z), flush);
+		if (status == Z_STREAM_ERROR)
+			return 1;
+		if (w->z.avail_out == 0 || (flush == Z_FINISH && status == Z_STREAM_END)) {
+			if (write_chunk(w, "IDAT", w->idat.data(), IDAT_SZ - w->z.avail_out) != 0)
+				return 1;
+			w->z.next_out = w->idat.data();
+			w->z.avail_out = IDAT_SZ;
+		}
+	} while (w->z.avail_in > 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+	return 0;
+}
+
+// Sub filter, each byte minus the same channel of the pixel to the left
+static int png_row(struct png_writer *w, const unsigned char *rgb)
+{
+	size_t sz = w->line.size() - 1;
+
+	w->line[0] = 1;
+	for (size_t i = 0; i < sz; i++)
+		w->line[1 + i] = rgb[i] - (i >= 3 ? rgb[i - 3] : 0);
+
+	w->z.next_in = w->line.data();
+	w->z.avail_in = w->line.size();
+	return png_deflate(w, Z_NO_FLUSH);
+}
+
+static int png_end(struct png_writer *w, bool ok)
+{
+	int rv = ok ? 0 : 1;
+
+	if (ok && (png_deflate(w, Z_FINISH) != 0 || write_chunk(w, "IEND", NULL, 0) != 0))
+		rv = 1;
+	deflateEnd(&(w->z));
+	if (fclose(w->f) != 0)
+		rv = 1;
+	return rv;
+}
+
+int still_render(const struct still_config *config, const still_draw_fn &draw_tile)
+{
+	int rv = 0;
+	int width = config->width, height = config->height;
+	GLint max_viewport[2], max_rb;
+	int tile;
+	GLuint fbo, rbo;
+	struct png_writer png;
+	std::vector<unsigned char> band;
+
+	glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport);
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_rb);
+	tile = std::min({ STILL_TILE_SIZE, max_viewport[0], max_viewport[1], (int)max_rb });
+
+	glGenRenderbuffers(1, &rbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, tile, tile);
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);
+
+	if (png_begin(&png, config->path, width, height) != 0) {
+		fprintf(stderr, "Failed to write %s\n", config->path);
+		rv = 1;
+		goto out;
+	}
+
+	// One row of tiles, bottom row first like GL has it
+	band.resize((size_t)tile * width * 3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_PACK_ROW_LENGTH, width);
+
+	// PNG goes top down, so the tile rows do too
+	for (int top = 0; top < height && rv == 0; top += tile) {
+		int th = std::min(tile, height - top);
+		int bottom = height - top - th; // In GL coordinates
+
+		for (int x = 0; x < width; x += tile) {
+			int tw = std::min(tile, width - x);
+
+			glViewport(0, 0, tw, th);
+			draw_tile((float)x / width, (float)bottom / height,
+			          (float)tw / width, (float)th / height);
+			glReadPixels(0, 0, tw, th, GL_RGB, GL_UNSIGNED_BYTE, band.data() + (size_t)x * 3);
+		}
+
+		for (int y = th - 1; y >= 0 && rv == 0; y--)
+			rv = png_row(&png, band.data() + (size_t)y * width * 3);
+	}
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+	if (png_end(&png, rv == 0) != 0) {
+		fprintf(stderr, "Failed to write %s\n", config->path);
+		rv = 1;
+	}
+out:
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &rbo);
+	return rv;
+}
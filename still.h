@@ -0,0 +1,25 @@
+#ifndef STILL_H
+#define STILL_H
+
+#include <functional>
+
+// Largest tile drawn at once. Also keeps single draws short enough not to
+// trip the driver's GPU hang detection at huge sizes
+#define STILL_TILE_SIZE 1024
+
+struct still_config {
+	int width, height;
+	unsigned frame; // Of the animation, counting from 1
+	const char *path;
+};
+
+// Draws the part of the frame from (x, y) to (x + w, y + h) to the whole
+// viewport. The frame goes from 0 to 1 both ways, y up
+typedef std::function<void(float x, float y, float w, float h)> still_draw_fn;
+
+// Renders a frame of any size tile by tile into a PNG. Only one row of tiles
+// is kept in memory, rows are compressed and written out as they finish.
+// Returns nonzero on errors
+int still_render(const struct still_config *config, const still_draw_fn &draw_tile);
+
+#endif
@@ -0,0 +1,71 @@
+// bench_compare on made up runs: no regression against itself, a regression
+// against a run that is 20% slower, and no comparison at all between runs
+// made with different settings
+#include <cstdio>
+#include <random>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define CHECK_FRAMES 600
+
+static void append_run(const char *fn, const char *commit, float frame_us,
+                       unsigned num_balls, const char *renderer)
+{
+	struct bench_config config = {};
+	struct bench_run run;
+	std::minstd_rand gen(1);
+	std::normal_distribution<float> noise(0.0f, frame_us * 0.02f);
+
+	config.frames = CHECK_FRAMES;
+	config.num_balls = num_balls;
+	bench_run_init(&run, &config);
+	run.commit = commit;
+	run.cpu = "check";
+	run.renderer = renderer;
+	for (unsigned i = 0; i < CHECK_FRAMES; i++) {
+		bench_add_frame(&run, frame_us + noise(gen));
+		bench_add_gpu_time(&run, frame_us * 0.5f + noise(gen));
+	}
+	bench_append_result(fn, bench_run_to_json(&run));
+}
+
+static int expect(const char *fn, const char *base, const char *head, int want,
+                  const char *what)
+{
+	if (bench_compare(fn, base, head, BENCH_DEFAULT_THRESHOLD) == want)
+		return 0;
+	fprintf(stderr, "%s not reported right\n", what);
+	return 1;
+}
+
+int main(void)
+{
+	int rv = 0;
+	char fn[] = "check_bench.jsonl";
+
+	unlink(fn);
+	append_run(fn, "aaaa", 1000.0f, 32, "check");
+	append_run(fn, "bbbb", 1000.0f, 32, "check");
+	append_run(fn, "cccc", 1200.0f, 32, "check");
+	// Slower, but with other settings than the runs of aaaa
+	append_run(fn, "dddd", 1200.0f, 63, "check");
+	append_run(fn, "eeee", 1200.0f, 32, "other");
+	append_run(fn, "ffff-dirty", 1000.0f, 32, "check");
+	// Runs of gggg in two setups, only one of them comparable to aaaa
+	append_run(fn, "gggg", 1000.0f, 32, "check");
+	append_run(fn, "gggg", 2000.0f, 63, "check");
+
+	rv |= expect(fn, "aaaa", "bbbb", 0, "Equal runs");
+	rv |= expect(fn, "aaaa", "cccc", 2, "20% slower run");
+	rv |= expect(fn, "cccc", "aaaa", 0, "Improvement");
+	rv |= expect(fn, "aaaa", "hhhh", 1, "Missing commit");
+	rv |= expect(fn, "aaaa", "dddd", 1, "Different config");
+	rv |= expect(fn, "aaaa", "eeee", 1, "Different renderer");
+	rv |= expect(fn, "aaaa", "ffff", 1, "Dirty tree of a clean commit");
+	rv |= expect(fn, "aaaa", "ffff-dirty", 0, "Dirty tree");
+	rv |= expect(fn, "aaaa", "gggg", 0, "Runs in two setups");
+
+	unlink(fn);
+	return rv;
+}
@@ -0,0 +1,159 @@
+// The shard bookkeeping without rendering: the manifest round trip, claims,
+// taking over stale claims, resuming from snapshots and joining the shards
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+
+#include "shard.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			rv = 1; \
+		} \
+	} while (0)
+
+static void write_file(const std::string &path, const char *data)
+{
+	FILE *f = fopen(path.c_str(), "wb");
+
+	if (f == NULL)
+		return;
+	fputs(data, f);
+	fclose(f);
+}
+
+static std::string read_file(const std::string &path)
+{
+	std::string s;
+	char buf[256];
+	size_t n;
+	FILE *f = fopen(path.c_str(), "rb");
+
+	if (f == NULL)
+		return s;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		s.append(buf, n);
+	fclose(f);
+	return s;
+}
+
+static void remove_dir(const char *dir)
+{
+	struct dirent *e;
+	DIR *d = opendir(dir);
+
+	if (d == NULL)
+		return;
+	while ((e = readdir(d)) != NULL) {
+		if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0)
+			unlink((std::string(dir) + "/" + e->d_name).c_str());
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+// Rendered as a line per frame, with a Y4M header line in front
+static void render_shard(const struct shard_claim *claim)
+{
+	std::string data = "YUV4MPEG2 check\n";
+
+	for (unsigned i = 0; i < claim->frames; i++)
+		data += "FRAME " + std::to_string(claim->first + i) + "\n";
+	write_file(claim->part_path, data.c_str());
+}
+
+int main(void)
+{
+	int rv = 0;
+	char dir[] = "check_shard.XXXXXX";
+	struct shard_job job = {}, read = {}, other = {};
+	struct shard_claim c0, c1, c2, c;
+	struct timespec stale[2] = {};
+	std::string expected = "YUV4MPEG2 check\n";
+
+	if (mkdtemp(dir) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	// 10 frames in shards of 4, the last one short
+	job.record.frames = 10;
+	job.record.width = 160;
+	job.record.height = 90;
+	job.record.fps = 30;
+	job.record.format = RECORD_Y4M;
+	job.seed = 7;
+	job.shard_frames = 4;
+	job.output = std::string(dir) + "/joined.y4m";
+	job.compute = true;
+	job.half = true;
+	job.shader_dir = "/some dir/with spaces";
+	CHECK(shard_job_create(dir, &job) == 0);
+	CHECK(shard_count(&job) == 3);
+
+	CHECK(shard_job_read(dir, &read) == 0);
+	CHECK(read.record.frames == 10 && read.shard_frames == 4 && read.seed == 7);
+	CHECK(read.record.width == 160 && read.record.height == 90 && read.record.fps == 30);
+	CHECK(read.record.format == RECORD_Y4M && read.output == job.output);
+	CHECK(read.compute && !read.edge_aa && read.half && !read.dynamic_resolution);
+	CHECK(read.shader_dir == job.shader_dir);
+
+	// Creating the job again resumes the one in the directory
+	other.shard_frames = 1;
+	other.record.fps = 1;
+	CHECK(shard_job_create(dir, &other) == 0);
+	CHECK(other.record.frames == 10 && other.shard_frames == 4 && other.compute);
+
+	// Claims go in order, and a claimed shard is not claimed again
+	CHECK(shard_claim_next(dir, &job, &c0) == 0 && c0.index == 0);
+	CHECK(shard_claim_next(dir, &job, &c1) == 0 && c1.index == 1);
+	CHECK(shard_claim_next(dir, &job, &c2) == 0 && c2.index == 2);
+	CHECK(c2.first == 8 && c2.frames == 2);
+	CHECK(shard_claim_next(dir, &job, &c) == SHARD_NONE_LEFT);
+
+	// The worker of shard 1 dies, its claim goes stale and is taken over
+	stale[0].tv_sec = stale[1].tv_sec = time(NULL) - 2 * SHARD_CLAIM_TIMEOUT_S;
+	CHECK(utimensat(AT_FDCWD, c1.claim_path.c_str(), stale, 0) == 0);
+	CHECK(shard_claim_next(dir, &job, &c) == 0 && c.index == 1);
+	CHECK(shard_claim_next(dir, &job, &c1) == SHARD_NONE_LEFT);
+	c1 = c;
+
+	// An abandoned shard is claimed again, a finished one never
+	render_shard(&c0);
+	CHECK(shard_finish(&c0) == 0);
+	shard_abandon(&c2);
+	CHECK(access(c2.claim_path.c_str(), F_OK) != 0);
+	CHECK(shard_claim_next(dir, &job, &c2) == 0 && c2.index == 2);
+	CHECK(shard_claim_next(dir, &job, &c) == SHARD_NONE_LEFT);
+
+	// Workers resume from the latest complete snapshot before their shard
+	write_file(shard_snapshot_path(dir, 4), "");
+	write_file(shard_snapshot_path(dir, 8) + ".123", "");
+	CHECK(shard_nearest_snapshot(dir, 3) == 0);
+	CHECK(shard_nearest_snapshot(dir, 8) == 4);
+	write_file(shard_snapshot_path(dir, 8), "");
+	CHECK(shard_nearest_snapshot(dir, 8) == 8);
+
+	// All done, so coordinating without workers only joins the shards,
+	// with the header of the first one
+	render_shard(&c1);
+	render_shard(&c2);
+	CHECK(shard_finish(&c1) == 0 && shard_finish(&c2) == 0);
+	// Would wait for the missing shards forever
+	if (rv == 0) {
+		CHECK(shard_coordinate(dir, "/nonexistent", 0) == 0);
+		for (unsigned i = 0; i < 10; i++)
+			expected += "FRAME " + std::to_string(i) + "\n";
+		CHECK(read_file(job.output) == expected);
+	}
+
+	remove_dir(dir);
+	return rv;
+}
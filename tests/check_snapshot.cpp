@@ -0,0 +1,71 @@
+// A snapshot loads back bit exact, random generator included
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+#define CHECK_BALLS 5
+
+struct sim_data {
+	float time;
+	std::minstd_rand rndgen;
+	std::vector<struct vec3> ball_pos_rad, ball_color;
+	std::vector<struct vec2> ball_velocity;
+	std::vector<struct vec4> ball_params;
+	std::vector<float> ball_hue_velocity;
+	std::vector<struct rwp_vs> ball_rwp_velocity;
+
+	sim_data()
+		: time(0.0f)
+		, ball_pos_rad(CHECK_BALLS), ball_color(CHECK_BALLS)
+		, ball_velocity(CHECK_BALLS), ball_params(CHECK_BALLS)
+		, ball_hue_velocity(CHECK_BALLS), ball_rwp_velocity(CHECK_BALLS)
+	{}
+
+	struct sim_state state()
+	{
+		return { time, rndgen, ball_pos_rad, ball_color, ball_velocity,
+		         ball_params, ball_hue_velocity, ball_rwp_velocity };
+	}
+};
+
+template <typename T>
+static bool same(const std::vector<T> &a, const std::vector<T> &b)
+{
+	return memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+int main(void)
+{
+	struct sim_data a, b;
+	struct sim_state sa = a.state(), sb = b.state();
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	const char *fn = "check_snapshot.txt";
+
+	a.time = 1.0f / 3.0f;
+	for (int i = 0; i < CHECK_BALLS; i++) {
+		a.ball_pos_rad[i] = vec3(dist(a.rndgen), dist(a.rndgen), dist(a.rndgen));
+		a.ball_color[i] = vec3(dist(a.rndgen), dist(a.rndgen), dist(a.rndgen));
+		a.ball_velocity[i] = vec2(dist(a.rndgen), 1e-40f);
+		a.ball_params[i] = vec4(dist(a.rndgen), dist(a.rndgen), dist(a.rndgen), -0.0f);
+		a.ball_hue_velocity[i] = dist(a.rndgen);
+		a.ball_rwp_velocity[i] = rwp_vs(dist(a.rndgen), dist(a.rndgen), dist(a.rndgen));
+	}
+
+	if (save_snapshot(fn, &sa) != 0 || load_snapshot(fn, &sb) != 0) {
+		fprintf(stderr, "Failed to save or load %s\n", fn);
+		return 1;
+	}
+	unlink(fn);
+
+	if (memcmp(&a.time, &b.time, sizeof(float)) != 0 || a.rndgen != b.rndgen ||
+	    !same(a.ball_pos_rad, b.ball_pos_rad) || !same(a.ball_color, b.ball_color) ||
+	    !same(a.ball_velocity, b.ball_velocity) || !same(a.ball_params, b.ball_params) ||
+	    !same(a.ball_hue_velocity, b.ball_hue_velocity) ||
+	    !same(a.ball_rwp_velocity, b.ball_rwp_velocity)) {
+		fprintf(stderr, "Snapshot did not load back bit exact\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,61 @@
+// The masks tilebin_update keeps from frame to frame match binning
+// everything again. Runs without GL, tilebin_init and the upload are not
+// used
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "tilebin.h"
+
+#define CHECK_BALLS 63
+#define CHECK_STEPS 500
+
+static void reset(struct tilebin *tb)
+{
+	tb->width = 0;
+	tb->height = 0;
+	tb->rects.clear();
+	tb->dirty.clear();
+	tb->rebuilt = false;
+}
+
+int main(void)
+{
+	struct tilebin kept = {}, fresh = {};
+	std::minstd_rand gen(7);
+	std::uniform_real_distribution<float> pos(0.0f, 1.0f), step(-0.01f, 0.01f);
+	std::vector<GLfloat> pos_rad(CHECK_BALLS * 3);
+	float aspect_ratio = 16.0f / 9.0f;
+	unsigned mismatches = 0;
+
+	reset(&kept);
+	// Some balls start outside, so rects go empty and come back
+	for (int i = 0; i < CHECK_BALLS; i++) {
+		pos_rad[i * 3 + 0] = pos(gen) * (aspect_ratio + 0.4f) - 0.2f;
+		pos_rad[i * 3 + 1] = pos(gen) * 1.4f - 0.2f;
+		pos_rad[i * 3 + 2] = 0.01f + pos(gen) * 0.05f;
+	}
+
+	for (int s = 0; s < CHECK_STEPS; s++) {
+		for (int i = 0; i < CHECK_BALLS; i++) {
+			pos_rad[i * 3 + 0] += step(gen);
+			pos_rad[i * 3 + 1] += step(gen);
+		}
+		tilebin_update(&kept, pos_rad.data(), CHECK_BALLS, 1920, 1080, aspect_ratio, 0.05f);
+		for (GLuint tile : kept.dirty)
+			kept.is_dirty[tile] = false;
+		kept.dirty.clear();
+		kept.rebuilt = false;
+
+		reset(&fresh);
+		tilebin_update(&fresh, pos_rad.data(), CHECK_BALLS, 1920, 1080, aspect_ratio, 0.05f);
+		for (size_t t = 0; t < kept.masks.size(); t++)
+			mismatches += kept.masks[t] != fresh.masks[t];
+	}
+
+	if (mismatches != 0) {
+		fprintf(stderr, "%u tile masks differ from a rebuild\n", mismatches);
+		return 1;
+	}
+	return 0;
+}
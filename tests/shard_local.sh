@@ -0,0 +1,30 @@
+#!/bin/sh
+# Records a short clip in one process and again as a sharded job with local
+# workers, and checks that both come out byte for byte the same. Extra
+# arguments go to both runs, e.g. --compute
+#
+#   tests/shard_local.sh ./ph [options]
+
+PH=${1:?usage: $0 PH [options]}
+shift
+
+FRAMES=24
+SHARD_FRAMES=5
+SIZE=160x90
+SEED=7
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+"$PH" --seed $SEED --record $FRAMES --record-size $SIZE --record-format rgb24 \
+	--record-output "$dir/single.rgb" "$@" || { echo "single process recording failed"; exit 1; }
+
+"$PH" --coordinate "$dir/job" --seed $SEED --record $FRAMES --record-size $SIZE \
+	--record-format rgb24 --record-output "$dir/sharded.rgb" --shard-frames $SHARD_FRAMES \
+	--workers 3 "$@" || { echo "sharded recording failed"; exit 1; }
+
+if ! cmp "$dir/single.rgb" "$dir/sharded.rgb"; then
+	echo "sharded recording differs from the single process one"
+	exit 1
+fi
+echo "$FRAMES frames in shards of $SHARD_FRAMES match"
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cmath>
+
+#include "tilebin.h"
+
+void tilebin_init(struct tilebin *tb)
+{
+	tb->width = 0;
+	tb->height = 0;
+	tb->aspect_ratio = 0.0f;
+	tb->tail_critical_value = -1.0f;
+	tb->tiles_x = 0;
+	tb->tiles_y = 0;
+	tb->rebuilt = false;
+	tb->prg = 0;
+	tb->num_updates_loc = -1;
+	tb->updates_sz = 0;
+	glGenBuffers(1, &(tb->masks_buf));
+	glGenBuffers(1, &(tb->updates_buf));
+}
+
+void tilebin_destroy(struct tilebin *tb)
+{
+	glDeleteBuffers(1, &(tb->updates_buf));
+	glDeleteBuffers(1, &(tb->masks_buf));
+	glDeleteProgram(tb->prg);
+}
+
+void tilebin_set_program(struct tilebin *tb, GLuint prg)
+{
+	glDeleteProgram(tb->prg);
+	tb->prg = prg;
+	tb->num_updates_loc = glGetUniformLocation(prg, "num_updates");
+}
+
+// Same reach as CULL_RADIUS in fs.glsl: the field of a ball is at most
+// r^2 / d^2, which kill_tail zeroes at or below tail_critical_value
+static struct tile_rect ball_rect(const struct tilebin *tb, const GLfloat *pos_rad)
+{
+	struct tile_rect r;
+	float reach, x, y, rx, ry;
+
+	if (tb->tail_critical_value <= 0.0f)
+		return { 0, 0, tb->tiles_x - 1, tb->tiles_y - 1 };
+
+	// In pixels
+	reach = pos_rad[2] / std::sqrt(tb->tail_critical_value);
+	x  = pos_rad[0] / tb->aspect_ratio * tb->width;
+	y  = pos_rad[1] * tb->height;
+	rx = reach / tb->aspect_ratio * tb->width;
+	ry = reach * tb->height;
+
+	r.x0 = std::max((int)std::floor((x - rx) / COMPUTE_TILE_SIZE), 0);
+	r.y0 = std::max((int)std::floor((y - ry) / COMPUTE_TILE_SIZE), 0);
+	r.x1 = std::min((int)std::floor((x + rx) / COMPUTE_TILE_SIZE), tb->tiles_x - 1);
+	r.y1 = std::min((int)std::floor((y + ry) / COMPUTE_TILE_SIZE), tb->tiles_y - 1);
+	if (r.x0 > r.x1 || r.y0 > r.y1)
+		return { 0, 0, -1, -1 };
+	return r;
+}
+
+static bool rect_empty(const struct tile_rect &r)
+{
+	return r.x0 > r.x1 || r.y0 > r.y1;
+}
+
+static void mark(struct tilebin *tb, int tile)
+{
+	if (tb->rebuilt || tb->is_dirty[tile])
+		return;
+	tb->is_dirty[tile] = true;
+	tb->dirty.push_back(tile);
+}
+
+// Flips bit in the tiles of row y from x0 to x1
+static void flip_span(struct tilebin *tb, int y, int x0, int x1, uint64_t bit)
+{
+	for (int x = x0; x <= x1; x++) {
+		int tile = y * tb->tiles_x + x;
+		tb->masks[tile] ^= bit;
+		mark(tb, tile);
+	}
+}
+
+// Row by row, only the tiles in one rect but not the other are touched
+static void move_ball(struct tilebin *tb, const struct tile_rect &from,
+                      const struct tile_rect &to, uint64_t bit)
+{
+	bool from_empty = rect_empty(from), to_empty = rect_empty(to);
+	int y0 = from_empty ? to.y0 : (to_empty ? from.y0 : std::min(from.y0, to.y0));
+	int y1 = from_empty ? to.y1 : (to_empty ? from.y1 : std::max(from.y1, to.y1));
+
+	for (int y = y0; y <= y1; y++) {
+		bool in_from = !from_empty && y >= from.y0 && y <= from.y1;
+		bool in_to = !to_empty && y >= to.y0 && y <= to.y1;
+
+		if (in_from && in_to) {
+			// Symmetric difference of two spans, at most one piece
+			// on each side
+			flip_span(tb, y, std::min(from.x0, to.x0), std::max(from.x0, to.x0) - 1, bit);
+			flip_span(tb, y, std::min(from.x1, to.x1) + 1, std::max(from.x1, to.x1), bit);
+		} else if (in_from) {
+			flip_span(tb, y, from.x0, from.x1, bit);
+		} else if (in_to) {
+			flip_span(tb, y, to.x0, to.x1, bit);
+		}
+	}
+}
+
+static void rebuild(struct tilebin *tb, const GLfloat *pos_rad, GLuint num_balls)
+{
+	tb->masks.assign((size_t)tb->tiles_x * tb->tiles_y, 0);
+	tb->is_dirty.assign(tb->masks.size(), false);
+	tb->dirty.clear();
+	tb->rebuilt = true;
+
+	tb->rects.resize(num_balls);
+	for (GLuint i = 0; i < num_balls; i++) {
+		struct tile_rect r = ball_rect(tb, pos_rad + i * 3);
+
+		tb->rects[i] = r;
+		if (rect_empty(r))
+			continue;
+		for (int y = r.y0; y <= r.y1; y++)
+			flip_span(tb, y, r.x0, r.x1, (uint64_t)1 << i);
+	}
+}
+
+void tilebin_update(struct tilebin *tb, const GLfloat *pos_rad, GLuint num_balls,
+                    int width, int height, float aspect_ratio, float tail_critical_value)
+{
+	num_balls = std::min(num_balls, (GLuint)TILEBIN_MAX_BALLS);
+
+	if (width != tb->width || height != tb->height || aspect_ratio != tb->aspect_ratio ||
+	    tail_critical_value != tb->tail_critical_value || num_balls != tb->rects.size()) {
+		tb->width = width;
+		tb->height = height;
+		tb->aspect_ratio = aspect_ratio;
+		tb->tail_critical_value = tail_critical_value;
+		tb->tiles_x = (width + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE;
+		tb->tiles_y = (height + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE;
+		rebuild(tb, pos_rad, num_balls);
+		return;
+	}
+
+	for (GLuint i = 0; i < num_balls; i++) {
+		struct tile_rect r = ball_rect(tb, pos_rad + i * 3);
+		struct tile_rect &old = tb->rects[i];
+
+		if (r.x0 == old.x0 && r.y0 == old.y0 && r.x1 == old.x1 && r.y1 == old.y1)
+			continue;
+		move_ball(tb, old, r, (uint64_t)1 << i);
+		old = r;
+	}
+}
+
+static void upload_all(struct tilebin *tb)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tb->masks_buf);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, tb->masks.size() * sizeof(uint64_t),
+	             tb->masks.data(), GL_DYNAMIC_DRAW);
+}
+
+static void upload_changes(struct tilebin *tb)
+{
+	GLsizeiptr sz = tb->dirty.size() * sizeof(struct tile_update);
+
+	tb->updates.resize(tb->dirty.size());
+	for (size_t i = 0; i < tb->dirty.size(); i++) {
+		GLuint tile = tb->dirty[i];
+		struct tile_update *u = &(tb->updates[i]);
+
+		u->tile = tile;
+		u->mask_lo = (GLuint)tb->masks[tile];
+		u->mask_hi = (GLuint)(tb->masks[tile] >> 32);
+		u->pad = 0;
+	}
+
+	// Orphaned every frame, so the previous update can still be read
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tb->updates_buf);
+	if (sz > tb->updates_sz)
+		tb->updates_sz = std::max(sz, (GLsizeiptr)(TILEBIN_GROUP_SIZE * sizeof(struct tile_update)));
+	glBufferData(GL_SHADER_STORAGE_BUFFER, tb->updates_sz, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sz, tb->updates.data());
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILEBIN_MASKS_BINDING, tb->masks_buf);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILEBIN_UPDATES_BINDING, tb->updates_buf);
+	glUseProgram(tb->prg);
+	glProgramUniform1ui(tb->prg, tb->num_updates_loc, tb->dirty.size());
+	glDispatchCompute((tb->dirty.size() + TILEBIN_GROUP_SIZE - 1) / TILEBIN_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void tilebin_upload(struct tilebin *tb)
+{
+	if (tb->rebuilt || (!tb->dirty.empty() && tb->prg == 0))
+		upload_all(tb);
+	else if (!tb->dirty.empty())
+		upload_changes(tb);
+
+	for (GLuint tile : tb->dirty)
+		tb->is_dirty[tile] = false;
+	tb->dirty.clear();
+	tb->rebuilt = false;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILEBIN_MASKS_BINDING, tb->masks_buf);
+}
@@ -0,0 +1,79 @@
+#ifndef TILEBIN_H
+#define TILEBIN_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "compute.h"
+
+// Shader storage bindings of tile_masks and tile_updates in field_cs.glsl
+// and tilebin_cs.glsl
+#define TILEBIN_MASKS_BINDING   2
+#define TILEBIN_UPDATES_BINDING 3
+
+// Work group size of tilebin_cs.glsl
+#define TILEBIN_GROUP_SIZE 64
+
+// One bit per ball in a tile mask
+#define TILEBIN_MAX_BALLS 64
+
+// Tiles of a ball, inclusive. Empty if x0 > x1
+struct tile_rect {
+	int x0, y0, x1, y1;
+};
+
+// Must match the std430 layout of tile_update in tilebin_cs.glsl
+struct tile_update {
+	GLuint tile;
+	GLuint mask_lo, mask_hi;
+	GLuint pad;
+};
+static_assert(offsetof(struct tile_update, mask_lo) == 4 &&
+              offsetof(struct tile_update, mask_hi) == 8 &&
+              sizeof(struct tile_update) == 16, "tile_update does not match tilebin_cs.glsl");
+
+// Which balls can reach each COMPUTE_TILE_SIZE tile of the compute renderer,
+// as a bit mask per tile. Balls move a tiny bit per frame, so the masks are
+// kept from frame to frame and only the tiles a ball's bounds entered or
+// left are touched. Only those are sent to the GPU, where tilebin_cs.glsl
+// writes them into the masks field_cs.glsl reads. A new size, aspect ratio
+// or tail_critical_value bins everything again
+struct tilebin {
+	int width, height;
+	float aspect_ratio;
+	float tail_critical_value;
+	int tiles_x, tiles_y;
+
+	std::vector<uint64_t> masks;
+	std::vector<struct tile_rect> rects; // Per ball
+	std::vector<GLuint> dirty;           // Tiles changed since the upload
+	std::vector<bool> is_dirty;
+	bool rebuilt;                        // All tiles changed
+
+	GLuint prg;
+	GLint num_updates_loc;
+	GLuint masks_buf;
+	GLuint updates_buf;
+	GLsizeiptr updates_sz;
+	std::vector<struct tile_update> updates;
+
+};
+
+void tilebin_init(struct tilebin *tb);
+void tilebin_destroy(struct tilebin *tb);
+
+// Takes ownership of prg, built from tilebin_cs.glsl. Until there is one,
+// all masks are uploaded whenever any changes
+void tilebin_set_program(struct tilebin *tb, GLuint prg);
+
+// pos_rad is xyz per ball, like the ball_pos_rad uniform. At most
+// TILEBIN_MAX_BALLS
+void tilebin_update(struct tilebin *tb, const GLfloat *pos_rad, GLuint num_balls,
+                    int width, int height, float aspect_ratio, float tail_critical_value);
+
+// Sends the changes since the last upload and binds the masks for field_cs.glsl
+void tilebin_upload(struct tilebin *tb);
+
+#endif
@@ -0,0 +1,35 @@
+#version 460
+
+// Writes the tile masks that changed this frame into the ones field_cs.glsl
+// reads, see tilebin.h
+
+#define GROUP_SIZE 64 // TILEBIN_GROUP_SIZE in tilebin.h
+
+layout (local_size_x = GROUP_SIZE) in;
+
+// Same layout as struct tile_update in tilebin.h. The mask is two uints
+// rather than a uvec2, which std430 would align to 8 bytes
+struct tile_update {
+	uint tile;
+	uint mask_lo;
+	uint mask_hi;
+	uint pad;
+};
+
+layout (std430, binding = 2) writeonly buffer tile_masks {
+	uvec2 masks[];
+};
+
+layout (std430, binding = 3) readonly buffer tile_updates {
+	tile_update updates[];
+};
+
+uniform uint num_updates;
+
+void main()
+{
+	uint i = gl_GlobalInvocationID.x;
+
+	if (i < num_updates)
+		masks[updates[i].tile] = uvec2(updates[i].mask_lo, updates[i].mask_hi);
+}
@@ -0,0 +1,105 @@
+#include <cstddef>
+
+#include "uniforms.h"
+
+void uniform_cache_reset(struct uniform_cache *c, GLuint prg)
+{
+	c->prg = prg;
+	c->num_slots = 0;
+}
+
+// Returns the slot of loc and whether it already holds a value. If the
+// cache is full, returns NULL and the caller has to do the GL call every
+// time
+static struct uniform_slot *lookup(struct uniform_cache *c, GLint loc, bool *known)
+{
+	struct uniform_slot *slot;
+
+	for (GLuint i = 0; i < c->num_slots; i++) {
+		if (c->slots[i].loc == loc) {
+			*known = true;
+			return c->slots + i;
+		}
+	}
+	*known = false;
+	if (c->num_slots == UNIFORM_CACHE_SLOTS)
+		return NULL;
+
+	slot = c->slots + c->num_slots++;
+	slot->loc = loc;
+	return slot;
+}
+
+void uniform_cache_1f(struct uniform_cache *c, GLint loc, float f)
+{
+	struct uniform_slot *slot;
+	bool known;
+
+	// Uniforms the compiler optimized out need no calls at all. Nothing
+	// was saved by skipping them, so they are not counted as avoided
+	if (loc < 0)
+		return;
+	slot = lookup(c, loc, &known);
+	if (known && slot->f == f) {
+		c->avoided++;
+		return;
+	}
+	if (slot != NULL)
+		slot->f = f;
+
+	glProgramUniform1f(c->prg, loc, f);
+	c->calls++;
+}
+
+void uniform_cache_1ui(struct uniform_cache *c, GLint loc, GLuint ui)
+{
+	struct uniform_slot *slot;
+	bool known;
+
+	if (loc < 0)
+		return;
+	slot = lookup(c, loc, &known);
+	if (known && slot->ui == ui) {
+		c->avoided++;
+		return;
+	}
+	if (slot != NULL)
+		slot->ui = ui;
+
+	glProgramUniform1ui(c->prg, loc, ui);
+	c->calls++;
+}
+
+static bool array_changed(struct uniform_cache *c, GLint loc, GLuint count, GLuint version)
+{
+	struct uniform_slot *slot;
+	bool known;
+
+	if (loc < 0)
+		return false;
+	slot = lookup(c, loc, &known);
+	if (known && slot->count == count && slot->version == version) {
+		c->avoided++;
+		return false;
+	}
+	if (slot != NULL) {
+		slot->count = count;
+		slot->version = version;
+	}
+	c->calls++;
+	return true;
+}
+
+void uniform_cache_3fv(struct uniform_cache *c, GLint loc, GLuint count,
+                       const GLfloat *v, GLuint version)
+{
+	if (array_changed(c, loc, count, version))
+		glProgramUniform3fv(c->prg, loc, count, v);
+}
+
+void uniform_cache_4fv(struct uniform_cache *c, GLint loc, GLuint count,
+                       const GLfloat *v, GLuint version)
+{
+	if (array_changed(c, loc, count, version))
+		glProgramUniform4fv(c->prg, loc, count, v);
+}
@@ -0,0 +1,42 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <GL/glew.h>
+#include <cstdint>
+
+// Enough for every uniform of any one of our programs
+#define UNIFORM_CACHE_SLOTS 16
+
+struct uniform_slot {
+	GLint loc;
+	GLuint count;
+	GLuint version; // Arrays are compared by version
+	float f;
+	GLuint ui;
+};
+
+// What the uniforms of one program were last set to. Setters only call into
+// GL when the value (or for arrays, the version the caller gives) differs
+// from what the program already has
+struct uniform_cache {
+	GLuint prg;
+	GLuint num_slots;
+	struct uniform_slot slots[UNIFORM_CACHE_SLOTS];
+
+	uint64_t calls;
+	uint64_t avoided; // Redundant calls skipped, not ones on optimized out uniforms
+};
+
+// Forget everything, e.g. after (re)linking prg
+void uniform_cache_reset(struct uniform_cache *c, GLuint prg);
+
+void uniform_cache_1f (struct uniform_cache *c, GLint loc, float f);
+void uniform_cache_1ui(struct uniform_cache *c, GLint loc, GLuint ui);
+
+// Callers bump version whenever they change the array contents
+void uniform_cache_3fv(struct uniform_cache *c, GLint loc, GLuint count,
+                       const GLfloat *v, GLuint version);
+void uniform_cache_4fv(struct uniform_cache *c, GLint loc, GLuint count,
+                       const GLfloat *v, GLuint version);
+
+#endif
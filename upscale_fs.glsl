@@ -0,0 +1,44 @@
+#version 460
+
+// Edge aware upscaling of the field. Mostly bilinear, but texels that
+// differ a lot from the bilinear result lose weight, so ball edges stay
+// sharp instead of getting smeared over a few pixels
+
+#define EDGE_SHARPNESS 40.0
+
+layout (location = 0) out vec4 fragColor;
+
+in vec2 uv;
+
+uniform sampler2D src;
+
+// Part of src the field was drawn to
+uniform vec2 src_scale;
+
+float luma(vec3 c)
+{
+	return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+	vec2  size = vec2(textureSize(src, 0));
+	ivec2 last = ivec2(src_scale * size) - 1;
+	vec2  pos  = uv * src_scale * size - 0.5;
+	ivec2 base = ivec2(floor(pos));
+	vec2  f    = pos - vec2(base);
+
+	vec3 c00 = texelFetch(src, clamp(base,               ivec2(0), last), 0).rgb;
+	vec3 c10 = texelFetch(src, clamp(base + ivec2(1, 0), ivec2(0), last), 0).rgb;
+	vec3 c01 = texelFetch(src, clamp(base + ivec2(0, 1), ivec2(0), last), 0).rgb;
+	vec3 c11 = texelFetch(src, clamp(base + ivec2(1, 1), ivec2(0), last), 0).rgb;
+
+	vec4 w = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y),
+	              (1.0 - f.x) * f.y,         f.x * f.y);
+	vec3 bilinear = c00 * w.x + c10 * w.y + c01 * w.z + c11 * w.w;
+
+	vec4 dl = vec4(luma(c00), luma(c10), luma(c01), luma(c11)) - luma(bilinear);
+	w *= exp(-EDGE_SHARPNESS * dl * dl);
+
+	fragColor = vec4((c00 * w.x + c10 * w.y + c01 * w.z + c11 * w.w) / dot(w, vec4(1.0)), 1.0);
+}
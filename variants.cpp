@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstring>
+
+#include "variants.h"
+
+static bool key_equal(const struct variant_key *a, const struct variant_key *b)
+{
+	return a->num_balls == b->num_balls && a->star_corners == b->star_corners &&
+	       a->warp == b->warp && a->cull == b->cull && a->atlas == b->atlas &&
+	       a->edge_aa == b->edge_aa && a->half == b->half;
+}
+
+// The defines go right after the #version line, which has to come first.
+// #line keeps the compiler's line numbers matching fs.glsl
+static std::string variant_source(const std::string &src, const struct variant_key *key)
+{
+	std::string out;
+	char defines[256];
+	size_t version_end = src.find('\n');
+
+	if (version_end == std::string::npos)
+		return src;
+
+	snprintf(defines, sizeof(defines),
+	         "#define NUM_BALLS %u\n"
+	         "#define STAR_CORNERS %u\n"
+	         "#define WARP %d\n"
+	         "#define CULL %d\n"
+	         "#define ATLAS %d\n"
+	         "#define EDGE_AA %d\n"
+	         "#define HALF %d\n"
+	         "#line 2\n",
+	         key->num_balls, key->star_corners, key->warp ? 1 : 0, (int)key->cull,
+	         key->atlas ? 1 : 0, key->edge_aa ? 1 : 0, key->half ? 1 : 0);
+
+	out.reserve(src.size() + strlen(defines));
+	out.append(src, 0, version_end + 1);
+	out += defines;
+	out.append(src, version_end + 1, std::string::npos);
+	return out;
+}
+
+static void start_build(struct variant_cache *c, struct variant *v)
+{
+	std::string fs_src = variant_source(c->fs_src, &(v->key));
+
+	progbuild_start(&(v->build), c->vs_fn.c_str(), c->vs_src.data(), c->vs_src.size(),
+	                c->fs_fn.c_str(), fs_src.data(), fs_src.size());
+	v->building = true;
+	v->stale = false;
+}
+
+static void finish_build(struct variant_cache *c, struct variant *v, enum progbuild_state state)
+{
+	v->building = false;
+	if (v->stale) {
+		// Built from old sources
+		if (state == PROGBUILD_READY)
+			glDeleteProgram(v->build.prg);
+		start_build(c, v);
+		return;
+	}
+
+	if (state == PROGBUILD_FAILED) {
+		if (v->prg != 0)
+			fprintf(stderr, "Keeping the old build of %s\n", c->fs_fn.c_str());
+		v->failed = true;
+		return;
+	}
+	glDeleteProgram(v->prg);
+	v->prg = v->build.prg;
+	v->fresh = true;
+}
+
+void variant_cache_init(struct variant_cache *c, const char *vs_fn, const char *vs_src, GLint vs_sz,
+                        const char *fs_fn, const char *fs_src, GLint fs_sz)
+{
+	c->vs_fn = vs_fn;
+	c->fs_fn = fs_fn;
+	c->vs_src.assign(vs_src, vs_sz);
+	c->fs_src.assign(fs_src, fs_sz);
+	c->variants.clear();
+}
+
+void variant_cache_destroy(struct variant_cache *c)
+{
+	for (auto it = c->variants.begin(); it != c->variants.end(); ++it) {
+		struct variant *v = it->get();
+		if (v->building && progbuild_poll(&(v->build)) == PROGBUILD_READY)
+			glDeleteProgram(v->build.prg);
+		glDeleteProgram(v->prg);
+	}
+	c->variants.clear();
+}
+
+void variant_cache_set_sources(struct variant_cache *c, const char *vs_src, GLint vs_sz,
+                               const char *fs_src, GLint fs_sz)
+{
+	c->vs_src.assign(vs_src, vs_sz);
+	c->fs_src.assign(fs_src, fs_sz);
+
+	for (auto it = c->variants.begin(); it != c->variants.end(); ++it) {
+		(*it)->stale = true;
+		(*it)->failed = false;
+	}
+}
+
+struct variant *variant_cache_get(struct variant_cache *c, const struct variant_key *key)
+{
+	struct variant *v = NULL;
+	enum progbuild_state state;
+
+	for (auto it = c->variants.begin(); it != c->variants.end(); ++it) {
+		if (key_equal(&((*it)->key), key)) {
+			v = it->get();
+			break;
+		}
+	}
+
+	if (v == NULL) {
+		c->variants.emplace_back(new struct variant);
+		v = c->variants.back().get();
+		v->key = *key;
+		v->building = false;
+		v->failed = false;
+		v->prg = 0;
+		v->fresh = false;
+		start_build(c, v);
+	} else if (v->stale && !v->building && !v->failed) {
+		start_build(c, v);
+	}
+
+	// Cached programs are there right away
+	if (v->building) {
+		state = progbuild_poll(&(v->build));
+		if (state != PROGBUILD_PENDING)
+			finish_build(c, v, state);
+	}
+	return v;
+}
+
+void variant_cache_poll(struct variant_cache *c)
+{
+	for (auto it = c->variants.begin(); it != c->variants.end(); ++it) {
+		struct variant *v = it->get();
+		enum progbuild_state state;
+
+		if (!v->building)
+			continue;
+		state = progbuild_poll(&(v->build));
+		if (state != PROGBUILD_PENDING)
+			finish_build(c, v, state);
+	}
+}
+
+void variant_cache_wait(struct variant_cache *c)
+{
+	for (auto it = c->variants.begin(); it != c->variants.end(); ++it) {
+		struct variant *v = it->get();
+
+		while (v->building) {
+			progbuild_wait(&(v->build));
+			finish_build(c, v, progbuild_poll(&(v->build)));
+		}
+	}
+}
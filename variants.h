@@ -0,0 +1,84 @@
+#ifndef VARIANTS_H
+#define VARIANTS_H
+
+#include <GL/glew.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "progbuild.h"
+#include "uniforms.h"
+
+// Values of CULL in fs.glsl
+enum cull_mode {
+	CULL_NONE,
+	CULL_RADIUS, // Skip balls too far away to get past kill_tail
+};
+
+// What a build of fs.glsl is specialized for. Zero / true / CULL_NONE / false
+// everywhere is the generic program that can draw any scene
+struct variant_key {
+	GLuint num_balls;    // Exact ball count, 0 for the num_balls uniform
+	GLuint star_corners; // Corners of every ball, 0 if they differ
+	bool warp;           // false if no ball is warped
+	enum cull_mode cull;
+	bool atlas;          // Balls of many scenes from a buffer, see atlas.h
+	bool edge_aa;        // Flags edges for a second pass, see edge_aa.h
+	bool half;           // Colors mixed in half precision, see cpushade.h
+};
+
+// Uniforms of one ball program and what they are set to
+struct ball_uniforms {
+	GLint num_balls_loc;
+	GLint ball_pos_rad_loc;
+	GLint ball_color_loc;
+	GLint ball_params_loc;
+	GLint view_rect_loc;
+	GLint aa_pass_loc;
+	struct uniform_cache cache;
+};
+
+struct variant {
+	struct variant_key key;
+	struct progbuild build;
+	bool building;
+	bool stale;  // Sources changed since the build started
+	bool failed; // Do not retry until the sources change
+
+	// Latest good program, 0 until the first build is done. fresh is set
+	// whenever it changes, for the caller to look up uniforms again
+	GLuint prg;
+	bool fresh;
+	struct ball_uniforms uniforms;
+};
+
+// Builds of vs.glsl and fs.glsl, each compiled on first use. They are built
+// through progbuild, so get never waits for the compiler
+struct variant_cache {
+	std::string vs_fn, fs_fn;
+	std::string vs_src, fs_src;
+	std::vector<std::unique_ptr<struct variant>> variants;
+};
+
+void variant_cache_init(struct variant_cache *c, const char *vs_fn, const char *vs_src, GLint vs_sz,
+                        const char *fs_fn, const char *fs_src, GLint fs_sz);
+
+// Call after progbuild_destroy, the worker may still be using the builds
+void variant_cache_destroy(struct variant_cache *c);
+
+// Every variant is rebuilt from the new sources the next time it is used
+// and keeps its old program until then, or for good if the build fails
+void variant_cache_set_sources(struct variant_cache *c, const char *vs_src, GLint vs_sz,
+                               const char *fs_src, GLint fs_sz);
+
+// Starts building the variant if it has not been built from the current
+// sources yet. Check prg before using it
+struct variant *variant_cache_get(struct variant_cache *c, const struct variant_key *key);
+
+// Picks up finished builds without waiting
+void variant_cache_poll(struct variant_cache *c);
+
+// Waits for every build in progress
+void variant_cache_wait(struct variant_cache *c);
+
+#endif
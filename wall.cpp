@@ -0,0 +1,245 @@
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string>
+
+#include "wall.h"
+
+static std::string shm_name(const char *name)
+{
+	return std::string("/ph-wall-") + name;
+}
+
+// Shared between processes, so no FUTEX_PRIVATE_FLAG
+static void futex_wait(std::atomic<uint32_t> *word, uint32_t val, int timeout_ms)
+{
+	struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+
+	syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t> *word)
+{
+	syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Frame numbers wrap
+static bool before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+static int ms_left(std::chrono::steady_clock::time_point deadline)
+{
+	auto left = deadline - std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(left).count();
+}
+
+static int create(struct wall *w, int canvas_width, int canvas_height)
+{
+	std::string name = shm_name(w->name);
+	int fd;
+
+	// A previous authority that died leaves its wall behind
+	shm_unlink(name.c_str());
+	fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		return 1;
+	if (ftruncate(fd, sizeof(struct wall_shm)) != 0) {
+		close(fd);
+		shm_unlink(name.c_str());
+		return 1;
+	}
+	w->shm = (struct wall_shm *)mmap(NULL, sizeof(struct wall_shm), PROT_READ | PROT_WRITE,
+	                                 MAP_SHARED, fd, 0);
+	close(fd);
+	if (w->shm == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		return 1;
+	}
+
+	// Starts out zeroed, so nothing is published or claimed yet
+	w->shm->version = WALL_VERSION;
+	w->shm->canvas_width = canvas_width;
+	w->shm->canvas_height = canvas_height;
+	w->shm->claimed[0].store(WALL_ACTIVE);
+	w->index = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	w->shm->magic = WALL_MAGIC;
+	return 0;
+}
+
+static int join(struct wall *w)
+{
+	std::string name = shm_name(w->name);
+	struct wall_shm *shm;
+	uint32_t expected;
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+
+	if (fd < 0)
+		return 1;
+	shm = (struct wall_shm *)mmap(NULL, sizeof(struct wall_shm), PROT_READ | PROT_WRITE,
+	                              MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED)
+		return 1;
+	w->shm = shm;
+	if (shm->magic != WALL_MAGIC || shm->version != WALL_VERSION) {
+		errno = EPROTO;
+		return 1;
+	}
+
+	for (int i = 1; i < WALL_MAX_RENDERERS; i++) {
+		expected = WALL_FREE;
+		if (!shm->claimed[i].compare_exchange_strong(expected, WALL_LAGGING))
+			continue;
+		// Up to date as of now. Active from the first frame it draws
+		w->index = i;
+		w->frame = shm->frame.load(std::memory_order_acquire);
+		shm->done[i].store(w->frame, std::memory_order_release);
+		return 0;
+	}
+	errno = EBUSY;
+	return 1;
+}
+
+int wall_init(struct wall *w, const char *name, bool authority, int canvas_width, int canvas_height)
+{
+	int rv;
+
+	w->name = name;
+	w->authority = authority;
+	w->frame = 0;
+	w->shm = NULL;
+	w->index = -1;
+
+	rv = authority ? create(w, canvas_width, canvas_height) : join(w);
+	if (rv != 0) {
+		if (authority)
+			fprintf(stderr, "Failed to create wall %s: %s\n", name, strerror(errno));
+		else
+			fprintf(stderr, "Failed to join wall %s (is the authority running?): %s\n",
+			        name, strerror(errno));
+		if (w->shm != NULL && w->shm != MAP_FAILED)
+			munmap(w->shm, sizeof(struct wall_shm));
+		w->shm = NULL;
+	}
+	return rv;
+}
+
+void wall_destroy(struct wall *w)
+{
+	if (w->shm == NULL)
+		return;
+	w->shm->claimed[w->index].store(WALL_FREE, std::memory_order_release);
+	w->shm->arrivals.fetch_add(1);
+	futex_wake(&(w->shm->arrivals));
+	munmap(w->shm, sizeof(struct wall_shm));
+	if (w->authority)
+		shm_unlink(shm_name(w->name).c_str());
+	w->shm = NULL;
+}
+
+// Seqlock write, the slot stays odd until wall_publish
+struct wall_state *wall_next_state(struct wall *w)
+{
+	uint32_t slot = (w->frame + 1) % 2;
+	std::atomic<uint32_t> *seq = &(w->shm->state_seq[slot]);
+
+	seq->store(seq->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	return &(w->shm->states[slot]);
+}
+
+void wall_publish(struct wall *w)
+{
+	std::atomic<uint32_t> *seq = &(w->shm->state_seq[(w->frame + 1) % 2]);
+
+	w->frame++;
+	seq->store(seq->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	w->shm->frame.store(w->frame, std::memory_order_release);
+	futex_wake(&(w->shm->frame));
+}
+
+// False if the slot was being written before or during the copy
+static bool copy_state(struct wall *w, uint32_t frame)
+{
+	uint32_t slot = frame % 2;
+	uint32_t s1, s2;
+
+	s1 = w->shm->state_seq[slot].load(std::memory_order_acquire);
+	if (s1 % 2 != 0)
+		return false;
+	memcpy(&(w->state), &(w->shm->states[slot]), sizeof(w->state));
+	std::atomic_thread_fence(std::memory_order_acquire);
+	s2 = w->shm->state_seq[slot].load(std::memory_order_relaxed);
+	return s1 == s2;
+}
+
+const struct wall_state *wall_wait_state(struct wall *w)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(WALL_TIMEOUT_MS);
+	uint32_t latest;
+	int left;
+
+	for (;;) {
+		latest = w->shm->frame.load(std::memory_order_acquire);
+		// A torn copy means the authority has moved on, so try its latest
+		if (before(w->frame, latest) && copy_state(w, latest)) {
+			w->frame = latest;
+			return &(w->state);
+		}
+		left = ms_left(deadline);
+		if (left <= 0)
+			return NULL;
+		if (!before(w->frame, latest))
+			futex_wait(&(w->shm->frame), latest, left);
+	}
+}
+
+void wall_barrier(struct wall *w)
+{
+	struct wall_shm *shm = w->shm;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(WALL_TIMEOUT_MS);
+	uint32_t arrivals;
+	uint32_t lagging = WALL_LAGGING;
+	bool waiting;
+	int left;
+
+	shm->done[w->index].store(w->frame, std::memory_order_release);
+	shm->claimed[w->index].compare_exchange_strong(lagging, WALL_ACTIVE);
+	shm->arrivals.fetch_add(1);
+	futex_wake(&(shm->arrivals));
+
+	for (;;) {
+		arrivals = shm->arrivals.load(std::memory_order_acquire);
+		waiting = false;
+		for (int i = 0; i < WALL_MAX_RENDERERS; i++) {
+			if (shm->claimed[i].load() == WALL_ACTIVE &&
+			    before(shm->done[i].load(std::memory_order_acquire), w->frame))
+				waiting = true;
+		}
+		if (!waiting)
+			return;
+
+		left = ms_left(deadline);
+		if (left > 0) {
+			futex_wait(&(shm->arrivals), arrivals, left);
+			continue;
+		}
+		for (int i = 0; i < WALL_MAX_RENDERERS; i++) {
+			uint32_t active = WALL_ACTIVE;
+			if (before(shm->done[i].load(), w->frame) &&
+			    shm->claimed[i].compare_exchange_strong(active, WALL_LAGGING))
+				fprintf(stderr, "Wall renderer %d fell behind, not waiting for it\n", i);
+		}
+		return;
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef WALL_H
+#define WALL_H
+
+#include <atomic>
+#include <cstdint>
+
+#define WALL_MAGIC   0x4c415750u // "PWAL"
+#define WALL_VERSION 2u
+
+#define WALL_MAX_RENDERERS 16
+#define WALL_MAX_BALLS 63 // MAX_BALL_COUNT in fs.glsl
+
+// A renderer this late to a frame is left behind instead of holding up the
+// whole wall. It catches up on its own if it is alive
+#define WALL_TIMEOUT_MS 500
+
+// What the renderers need of a simulation step
+struct wall_state {
+	uint32_t num_balls;
+	float tail_critical_value;
+	float ball_pos_rad[WALL_MAX_BALLS][3];
+	float ball_color[WALL_MAX_BALLS][3];
+	float ball_params[WALL_MAX_BALLS][4];
+};
+
+// Lives in POSIX shared memory named after the wall. The authority writes
+// the state of frame f into states[f % 2] and then bumps frame. Frame f + 2
+// reuses the slot once every active renderer has drawn f + 1, but a lagging
+// one may still be copying f then. So each slot is a seqlock like the frame
+// export ring: state_seq is odd while the slot is written, and readers drop
+// a copy if it changed in between
+struct wall_shm {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t canvas_width, canvas_height;
+
+	std::atomic<uint32_t> frame;    // Latest published, futex word
+	std::atomic<uint32_t> arrivals; // Bumped by every done, futex word
+
+	// Per renderer, slot 0 is the authority
+	std::atomic<uint32_t> claimed[WALL_MAX_RENDERERS]; // enum wall_claim
+	std::atomic<uint32_t> done[WALL_MAX_RENDERERS];    // Last frame drawn
+
+	std::atomic<uint32_t> state_seq[2];
+	struct wall_state states[2];
+};
+
+enum wall_claim {
+	WALL_FREE,
+	WALL_ACTIVE,
+	WALL_LAGGING, // Timed out, not waited for until it arrives again
+};
+
+// One synchronized scene drawn by several processes, each its own part of a
+// large canvas. One of them, the authority, runs the simulation
+struct wall {
+	const char *name;
+	bool authority;
+	int index;
+	uint32_t frame; // Being drawn
+	struct wall_shm *shm;
+	struct wall_state state; // Renderers: copied out of shm
+};
+
+// The authority creates the wall, which the others join. Renderers get the
+// canvas size from it
+int wall_init(struct wall *w, const char *name, bool authority, int canvas_width, int canvas_height);
+void wall_destroy(struct wall *w);
+
+// Authority only: fill in the state of the next frame, then publish it.
+// Readers drop the slot from wall_next_state until wall_publish
+struct wall_state *wall_next_state(struct wall *w);
+void wall_publish(struct wall *w);
+
+// Renderers only: waits for a frame newer than the last one and returns a
+// copy of its state. Skips frames if behind. NULL if nothing came in time
+const struct wall_state *wall_wait_state(struct wall *w);
+
+// After drawing the frame, before showing it. Waits until every renderer
+// has drawn it, so that all of them show it at the same time
+void wall_barrier(struct wall *w);
+
+#endif